@@ -28,4 +28,6 @@
 
 i3ipcCon *i3ipc_con_new(i3ipcCon *parent, JsonObject *data, i3ipcConnection *conn);
 
+gulong i3ipc_con_get_id(i3ipcCon *self);
+
 #endif /* __I3IPC_CON_PRIVATE_H__ */
@@ -696,6 +696,13 @@ const gchar *i3ipc_con_get_name(i3ipcCon *self) {
     return self->priv->name;
 }
 
+/*
+ * The "id" property of the Con, without going through g_object_get().
+ */
+gulong i3ipc_con_get_id(i3ipcCon *self) {
+    return self->priv->id;
+}
+
 /**
  * i3ipc_con_command:
  * @self: an #i3ipcCon
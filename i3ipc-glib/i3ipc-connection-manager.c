@@ -0,0 +1,741 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ */
+
+#include "i3ipc-connection-manager.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#ifdef I3IPC_HAVE_EPOLL
+#include <sys/epoll.h>
+
+/* how many ready sockets are dispatched per iteration of the main loop */
+#define I3IPC_MANAGER_MAX_EVENTS 64
+#endif
+
+enum {
+    PROP_0,
+
+    PROP_SIZE,
+
+    N_PROPERTIES
+};
+
+static GParamSpec *obj_properties[N_PROPERTIES] = {
+    NULL,
+};
+
+enum {
+    WORKSPACE,
+    OUTPUT,
+    MODE,
+    WINDOW,
+    BARCONFIG_UPDATE,
+    BINDING,
+    CONNECTION_LOST,
+    LAST_SIGNAL
+};
+
+static guint manager_signals[LAST_SIGNAL] = {0};
+
+/* the signals of the connections that are emitted on the manager as well */
+static const gchar *const forwarded_signals[] = {
+    "workspace", "output", "mode", "window", "barconfig_update", "binding",
+};
+
+/*
+ * A connection of the manager. @fd is the subscription socket while it is
+ * watched, or -1. @fd_tag is set when the socket is watched by the source
+ * itself instead of an epoll instance.
+ */
+typedef struct {
+    i3ipcConnection *conn;
+    gint fd;
+    gpointer fd_tag;
+} i3ipcManagedConnection;
+
+struct _i3ipcConnectionManagerPrivate {
+    GHashTable *members;
+    GHashTable *by_fd;
+    /* connections that may have events buffered without their socket being
+     * readable, such as right after a subscription */
+    GQueue *kicked;
+    GSource *source;
+    i3ipcEvent subscriptions;
+#ifdef I3IPC_HAVE_EPOLL
+    gint epoll_fd;
+    gpointer epoll_tag;
+#endif
+};
+
+/*
+ * Watches the subscription sockets of all the connections of a manager.
+ */
+typedef struct {
+    GSource source;
+    i3ipcConnectionManager *manager;
+} i3ipcManagerSource;
+
+G_DEFINE_TYPE_WITH_PRIVATE(i3ipcConnectionManager, i3ipc_connection_manager, G_TYPE_OBJECT);
+
+/*
+ * Whether the sockets are watched through an epoll instance. Without one, the
+ * source watches every socket itself.
+ */
+static gboolean ipc_manager_has_epoll(i3ipcConnectionManager *self) {
+#ifdef I3IPC_HAVE_EPOLL
+    return self->priv->epoll_fd >= 0;
+#else
+    return FALSE;
+#endif
+}
+
+static void ipc_manager_unwatch(i3ipcConnectionManager *self, i3ipcManagedConnection *entry) {
+    if (entry->fd < 0) {
+        return;
+    }
+
+#ifdef I3IPC_HAVE_EPOLL
+    /* fails harmlessly when the socket was closed, which already removed it */
+    if (self->priv->epoll_fd >= 0) {
+        epoll_ctl(self->priv->epoll_fd, EPOLL_CTL_DEL, entry->fd, NULL);
+    }
+#endif
+
+    if (entry->fd_tag != NULL) {
+        g_source_remove_unix_fd(self->priv->source, entry->fd_tag);
+        entry->fd_tag = NULL;
+    }
+
+    if (g_hash_table_lookup(self->priv->by_fd, GINT_TO_POINTER(entry->fd)) == entry) {
+        g_hash_table_remove(self->priv->by_fd, GINT_TO_POINTER(entry->fd));
+    }
+
+    entry->fd = -1;
+}
+
+/*
+ * Makes sure the connection is dispatched in the next iteration even when
+ * its socket does not become readable.
+ */
+static void ipc_manager_kick(i3ipcConnectionManager *self, i3ipcManagedConnection *entry) {
+    if (g_queue_find(self->priv->kicked, entry) == NULL) {
+        g_queue_push_tail(self->priv->kicked, entry);
+    }
+}
+
+/*
+ * Starts watching the subscription socket of a connection, which is opened
+ * if it is not yet.
+ */
+static gboolean ipc_manager_watch(i3ipcConnectionManager *self, i3ipcManagedConnection *entry,
+                                  GError **err) {
+    gint fd = i3ipc_connection_get_event_fd(entry->conn);
+
+    ipc_manager_unwatch(self, entry);
+
+    if (fd < 0) {
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                            "Could not open the event socket");
+        return FALSE;
+    }
+
+#ifdef I3IPC_HAVE_EPOLL
+    if (self->priv->epoll_fd >= 0) {
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = fd};
+
+        if (epoll_ctl(self->priv->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                        "Could not watch the event socket (%s)", strerror(errno));
+            return FALSE;
+        }
+    }
+#endif
+
+    if (!ipc_manager_has_epoll(self)) {
+        entry->fd_tag =
+            g_source_add_unix_fd(self->priv->source, fd, G_IO_IN | G_IO_HUP | G_IO_ERR);
+    }
+
+    entry->fd = fd;
+    g_hash_table_insert(self->priv->by_fd, GINT_TO_POINTER(fd), entry);
+    ipc_manager_kick(self, entry);
+
+    return TRUE;
+}
+
+static void ipc_manager_entry_free(gpointer data) {
+    i3ipcManagedConnection *entry = data;
+
+    g_object_unref(entry->conn);
+    g_slice_free(i3ipcManagedConnection, entry);
+}
+
+/*
+ * Emits an event of one of the connections on the manager, with the same
+ * detail.
+ */
+static void ipc_manager_on_event(i3ipcConnection *conn, gpointer event, gpointer user_data) {
+    i3ipcConnectionManager *self = user_data;
+    GSignalInvocationHint *hint = g_signal_get_invocation_hint(conn);
+    guint signal_id = g_signal_lookup(g_signal_name(hint->signal_id),
+                                      I3IPC_TYPE_CONNECTION_MANAGER);
+
+    if (g_signal_has_handler_pending(self, signal_id, hint->detail, FALSE)) {
+        g_signal_emit(self, signal_id, hint->detail, conn, event);
+    }
+}
+
+/*
+ * Forwards the events of the types in @events from a connection. Only the
+ * types the manager subscribed to get a forwarder, so the connection still
+ * skips decoding the others and can drop subscriptions nobody listens to.
+ */
+static void ipc_manager_forward(i3ipcConnectionManager *self, i3ipcConnection *conn,
+                                i3ipcEvent events) {
+    for (guint i = 0; i < G_N_ELEMENTS(forwarded_signals); i += 1) {
+        if (events & (1 << i)) {
+            g_signal_connect(conn, forwarded_signals[i], G_CALLBACK(ipc_manager_on_event), self);
+        }
+    }
+}
+
+static void ipc_manager_on_shutdown(i3ipcConnection *conn, gpointer user_data) {
+    i3ipcConnectionManager *self = user_data;
+
+    g_signal_emit(self, manager_signals[CONNECTION_LOST], 0, conn);
+}
+
+/*
+ * The subscription socket of a connection is a new one after it reconnected.
+ */
+static void ipc_manager_on_reconnected(i3ipcConnection *conn, gint64 gap, gpointer user_data) {
+    i3ipcConnectionManager *self = user_data;
+    i3ipcManagedConnection *entry = g_hash_table_lookup(self->priv->members, conn);
+    GError *err = NULL;
+
+    if (entry != NULL && !ipc_manager_watch(self, entry, &err)) {
+        g_warning("could not watch the connection again (%s)\n", err->message);
+        g_error_free(err);
+    }
+}
+
+/*
+ * Lets a connection read what is ready on its sockets and emit its events.
+ * Its socket is no longer watched once the connection was lost.
+ */
+static void ipc_manager_dispatch(i3ipcConnectionManager *self, i3ipcConnection *conn) {
+    i3ipcManagedConnection *entry;
+    GError *err = NULL;
+
+    if (i3ipc_connection_dispatch_ready(conn, &err)) {
+        return;
+    }
+
+    g_error_free(err);
+
+    /* a handler may have removed it */
+    entry = g_hash_table_lookup(self->priv->members, conn);
+
+    if (entry != NULL) {
+        ipc_manager_unwatch(self, entry);
+    }
+}
+
+static gboolean ipc_manager_source_prepare(GSource *source, gint *timeout) {
+    i3ipcManagerSource *manager_source = (i3ipcManagerSource *)source;
+
+    *timeout = -1;
+
+    return !g_queue_is_empty(manager_source->manager->priv->kicked);
+}
+
+static gboolean ipc_manager_source_check(GSource *source) {
+    i3ipcManagerSource *manager_source = (i3ipcManagerSource *)source;
+
+    return !g_queue_is_empty(manager_source->manager->priv->kicked);
+}
+
+/*
+ * Collects the connections that have something to read first, since the
+ * handlers they run may add and remove connections.
+ */
+static gboolean ipc_manager_source_dispatch(GSource *source, GSourceFunc callback,
+                                            gpointer user_data) {
+    i3ipcConnectionManager *self = ((i3ipcManagerSource *)source)->manager;
+    GPtrArray *ready = g_ptr_array_new_with_free_func(g_object_unref);
+    i3ipcManagedConnection *entry;
+
+    while ((entry = g_queue_pop_head(self->priv->kicked)) != NULL) {
+        g_ptr_array_add(ready, g_object_ref(entry->conn));
+    }
+
+#ifdef I3IPC_HAVE_EPOLL
+    if (self->priv->epoll_tag != NULL &&
+        g_source_query_unix_fd(source, self->priv->epoll_tag) != 0) {
+        struct epoll_event events[I3IPC_MANAGER_MAX_EVENTS];
+        /* whatever does not fit keeps the epoll fd readable for the next round */
+        gint n = epoll_wait(self->priv->epoll_fd, events, I3IPC_MANAGER_MAX_EVENTS, 0);
+
+        for (gint i = 0; i < n; i += 1) {
+            entry = g_hash_table_lookup(self->priv->by_fd, GINT_TO_POINTER(events[i].data.fd));
+
+            if (entry != NULL) {
+                g_ptr_array_add(ready, g_object_ref(entry->conn));
+            }
+        }
+    }
+#endif
+
+    if (!ipc_manager_has_epoll(self)) {
+        GHashTableIter iter;
+
+        g_hash_table_iter_init(&iter, self->priv->members);
+
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)) {
+            if (entry->fd_tag != NULL && g_source_query_unix_fd(source, entry->fd_tag) != 0) {
+                g_ptr_array_add(ready, g_object_ref(entry->conn));
+            }
+        }
+    }
+
+    g_object_ref(self);
+
+    for (guint i = 0; i < ready->len; i += 1) {
+        i3ipcConnection *conn = g_ptr_array_index(ready, i);
+
+        if (g_hash_table_contains(self->priv->members, conn)) {
+            ipc_manager_dispatch(self, conn);
+        }
+    }
+
+    g_object_unref(self);
+    g_ptr_array_unref(ready);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs ipc_manager_source_funcs = {
+    ipc_manager_source_prepare,
+    ipc_manager_source_check,
+    ipc_manager_source_dispatch,
+    NULL,
+};
+
+static void i3ipc_connection_manager_get_property(GObject *object, guint property_id,
+                                                  GValue *value, GParamSpec *pspec) {
+    i3ipcConnectionManager *self = I3IPC_CONNECTION_MANAGER(object);
+
+    switch (property_id) {
+    case PROP_SIZE:
+        g_value_set_uint(value, g_hash_table_size(self->priv->members));
+        break;
+
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void i3ipc_connection_manager_dispose(GObject *gobject) {
+    i3ipcConnectionManager *self = I3IPC_CONNECTION_MANAGER(gobject);
+    GList *conns = g_hash_table_get_keys(self->priv->members);
+
+    for (GList *l = conns; l != NULL; l = l->next) {
+        i3ipc_connection_manager_remove(self, l->data);
+    }
+
+    g_list_free(conns);
+
+    if (self->priv->source != NULL) {
+        g_source_destroy(self->priv->source);
+        g_clear_pointer(&self->priv->source, g_source_unref);
+    }
+
+    G_OBJECT_CLASS(i3ipc_connection_manager_parent_class)->dispose(gobject);
+}
+
+static void i3ipc_connection_manager_finalize(GObject *gobject) {
+    i3ipcConnectionManager *self = I3IPC_CONNECTION_MANAGER(gobject);
+
+#ifdef I3IPC_HAVE_EPOLL
+    if (self->priv->epoll_fd >= 0) {
+        close(self->priv->epoll_fd);
+    }
+#endif
+
+    g_hash_table_unref(self->priv->by_fd);
+    g_hash_table_unref(self->priv->members);
+    g_queue_free(self->priv->kicked);
+
+    G_OBJECT_CLASS(i3ipc_connection_manager_parent_class)->finalize(gobject);
+}
+
+static void i3ipc_connection_manager_class_init(i3ipcConnectionManagerClass *klass) {
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    const GType event_types[] = {
+        I3IPC_TYPE_WORKSPACE_EVENT, I3IPC_TYPE_GENERIC_EVENT,          I3IPC_TYPE_GENERIC_EVENT,
+        I3IPC_TYPE_WINDOW_EVENT,    I3IPC_TYPE_BARCONFIG_UPDATE_EVENT, I3IPC_TYPE_BINDING_EVENT,
+    };
+
+    gobject_class->get_property = i3ipc_connection_manager_get_property;
+    gobject_class->dispose = i3ipc_connection_manager_dispose;
+    gobject_class->finalize = i3ipc_connection_manager_finalize;
+
+    obj_properties[PROP_SIZE] =
+        g_param_spec_uint("size", "Manager size", "The number of connections in the manager", 0,
+                          G_MAXUINT, 0, G_PARAM_READABLE);
+
+    g_object_class_install_properties(gobject_class, N_PROPERTIES, obj_properties);
+
+    /**
+     * i3ipcConnectionManager::workspace:
+     * @self: the #i3ipcConnectionManager on which the signal was emitted
+     * @conn: the #i3ipcConnection that received the event
+     * @e: The workspace event object
+     *
+     * Sent when a connection of the manager emits #i3ipcConnection::workspace,
+     * with the same detail.
+     */
+    /**
+     * i3ipcConnectionManager::output:
+     * @self: the #i3ipcConnectionManager on which the signal was emitted
+     * @conn: the #i3ipcConnection that received the event
+     * @e: The output event object
+     *
+     * Sent when a connection of the manager emits #i3ipcConnection::output,
+     * with the same detail.
+     */
+    /**
+     * i3ipcConnectionManager::mode:
+     * @self: the #i3ipcConnectionManager on which the signal was emitted
+     * @conn: the #i3ipcConnection that received the event
+     * @e: The mode event object
+     *
+     * Sent when a connection of the manager emits #i3ipcConnection::mode,
+     * with the same detail.
+     */
+    /**
+     * i3ipcConnectionManager::window:
+     * @self: the #i3ipcConnectionManager on which the signal was emitted
+     * @conn: the #i3ipcConnection that received the event
+     * @e: The window event object
+     *
+     * Sent when a connection of the manager emits #i3ipcConnection::window,
+     * with the same detail.
+     */
+    /**
+     * i3ipcConnectionManager::barconfig_update:
+     * @self: the #i3ipcConnectionManager on which the signal was emitted
+     * @conn: the #i3ipcConnection that received the event
+     * @e: The barconfig update event object
+     *
+     * Sent when a connection of the manager emits
+     * #i3ipcConnection::barconfig_update.
+     */
+    /**
+     * i3ipcConnectionManager::binding:
+     * @self: the #i3ipcConnectionManager on which the signal was emitted
+     * @conn: the #i3ipcConnection that received the event
+     * @e: The binding event object
+     *
+     * Sent when a connection of the manager emits #i3ipcConnection::binding,
+     * with the same detail.
+     */
+    for (guint i = 0; i < G_N_ELEMENTS(forwarded_signals); i += 1) {
+        manager_signals[WORKSPACE + i] =
+            g_signal_new(forwarded_signals[i],                   /* signal_name */
+                         I3IPC_TYPE_CONNECTION_MANAGER,          /* itype */
+                         G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
+                         0,                                      /* class_offset */
+                         NULL,                                   /* accumulator */
+                         NULL,                                   /* accu_data */
+                         g_cclosure_marshal_generic,             /* c_marshaller */
+                         G_TYPE_NONE,                            /* return_type */
+                         2,                                      /* n_params */
+                         I3IPC_TYPE_CONNECTION, event_types[i] | G_SIGNAL_TYPE_STATIC_SCOPE);
+    }
+
+    /**
+     * i3ipcConnectionManager::connection-lost:
+     * @self: the #i3ipcConnectionManager on which the signal was emitted
+     * @conn: the #i3ipcConnection that lost its ipc
+     *
+     * Sent when a connection of the manager emits
+     * #i3ipcConnection::ipc_shutdown. With #i3ipcConnection:auto-reconnect
+     * set, the manager watches the connection again once it reconnected.
+     */
+    manager_signals[CONNECTION_LOST] =
+        g_signal_new("connection-lost",                /* signal_name */
+                     I3IPC_TYPE_CONNECTION_MANAGER,    /* itype */
+                     G_SIGNAL_RUN_FIRST,               /* signal_flags */
+                     0,                                /* class_offset */
+                     NULL,                             /* accumulator */
+                     NULL,                             /* accu_data */
+                     g_cclosure_marshal_VOID__OBJECT,  /* c_marshaller */
+                     G_TYPE_NONE,                      /* return_type */
+                     1, I3IPC_TYPE_CONNECTION);        /* n_params */
+}
+
+static void i3ipc_connection_manager_init(i3ipcConnectionManager *self) {
+    self->priv = i3ipc_connection_manager_get_instance_private(self);
+    self->priv->members = g_hash_table_new_full(NULL, NULL, NULL, ipc_manager_entry_free);
+    self->priv->by_fd = g_hash_table_new(NULL, NULL);
+    self->priv->kicked = g_queue_new();
+#ifdef I3IPC_HAVE_EPOLL
+    self->priv->epoll_fd = -1;
+#endif
+}
+
+/**
+ * i3ipc_connection_manager_new:
+ * @context: (allow-none): The context to emit the events from, or NULL for
+ * the thread-default context
+ *
+ * Creates a manager without connections. Its source is attached to @context,
+ * and the events of all its connections are emitted from there.
+ *
+ * Returns: (transfer full): a new #i3ipcConnectionManager
+ */
+i3ipcConnectionManager *i3ipc_connection_manager_new(GMainContext *context) {
+    i3ipcConnectionManager *self = g_object_new(I3IPC_TYPE_CONNECTION_MANAGER, NULL);
+    i3ipcManagerSource *source;
+
+    if (context == NULL) {
+        context = g_main_context_get_thread_default();
+    }
+
+    source = (i3ipcManagerSource *)g_source_new(&ipc_manager_source_funcs,
+                                                sizeof(i3ipcManagerSource));
+    source->manager = self;
+    self->priv->source = (GSource *)source;
+
+#ifdef I3IPC_HAVE_EPOLL
+    self->priv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    /* without an epoll instance the source watches every socket itself */
+    if (self->priv->epoll_fd >= 0) {
+        self->priv->epoll_tag =
+            g_source_add_unix_fd(self->priv->source, self->priv->epoll_fd, G_IO_IN);
+    } else {
+        g_debug("could not create an epoll instance (%s)", strerror(errno));
+    }
+#endif
+
+    g_source_set_name(self->priv->source, "i3ipc connection manager");
+    g_source_attach(self->priv->source, context);
+
+    return self;
+}
+
+/**
+ * i3ipc_connection_manager_add:
+ * @self: An #i3ipcConnectionManager
+ * @conn: The #i3ipcConnection to add
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Adds a connection to the manager. Its events are no longer processed from
+ * its own #GMainContext but from the source of the manager, see
+ * i3ipc_connection_detach(). The connection is subscribed to the events of
+ * i3ipc_connection_manager_subscribe(). When that fails, @conn is left out of
+ * the manager as it was.
+ *
+ * Returns: TRUE when the subscription socket of @conn is watched
+ */
+gboolean i3ipc_connection_manager_add(i3ipcConnectionManager *self, i3ipcConnection *conn,
+                                      GError **err) {
+    i3ipcManagedConnection *entry;
+    i3ipcCommandReply *reply;
+    GError *tmp_error = NULL;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION_MANAGER(self), FALSE);
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(conn), FALSE);
+    g_return_val_if_fail(err == NULL || *err == NULL, FALSE);
+
+    if (g_hash_table_contains(self->priv->members, conn)) {
+        return TRUE;
+    }
+
+    entry = g_slice_new0(i3ipcManagedConnection);
+    entry->conn = g_object_ref(conn);
+    entry->fd = -1;
+    g_hash_table_insert(self->priv->members, conn, entry);
+
+    i3ipc_connection_detach(conn);
+
+    ipc_manager_forward(self, conn, self->priv->subscriptions);
+
+    g_signal_connect(conn, "ipc_shutdown", G_CALLBACK(ipc_manager_on_shutdown), self);
+    g_signal_connect(conn, "reconnected", G_CALLBACK(ipc_manager_on_reconnected), self);
+
+    if (self->priv->subscriptions != 0) {
+        reply = i3ipc_connection_subscribe(conn, self->priv->subscriptions, &tmp_error);
+
+        if (reply != NULL) {
+            i3ipc_command_reply_free(reply);
+        }
+    }
+
+    if (tmp_error == NULL) {
+        ipc_manager_watch(self, entry, &tmp_error);
+    }
+
+    if (tmp_error != NULL) {
+        /* undoes the setup, which attaches the connection again */
+        i3ipc_connection_manager_remove(self, conn);
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * i3ipc_connection_manager_add_socket:
+ * @self: An #i3ipcConnectionManager
+ * @socket_path: the path of the socket to connect to
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Connects to the ipc at @socket_path and adds the connection to the manager.
+ *
+ * Returns: (transfer none): the new #i3ipcConnection, or NULL on failure
+ */
+i3ipcConnection *i3ipc_connection_manager_add_socket(i3ipcConnectionManager *self,
+                                                     const gchar *socket_path, GError **err) {
+    i3ipcConnection *conn;
+    gboolean added;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION_MANAGER(self), NULL);
+    g_return_val_if_fail(socket_path != NULL, NULL);
+
+    conn = i3ipc_connection_new(socket_path, err);
+
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    added = i3ipc_connection_manager_add(self, conn, err);
+    g_object_unref(conn);
+
+    return (added ? conn : NULL);
+}
+
+/**
+ * i3ipc_connection_manager_remove:
+ * @self: An #i3ipcConnectionManager
+ * @conn: a connection of the manager
+ *
+ * Takes a connection out of the manager. It processes its events from the
+ * thread-default #GMainContext again, see i3ipc_connection_attach().
+ */
+void i3ipc_connection_manager_remove(i3ipcConnectionManager *self, i3ipcConnection *conn) {
+    i3ipcManagedConnection *entry;
+
+    g_return_if_fail(I3IPC_IS_CONNECTION_MANAGER(self));
+    g_return_if_fail(I3IPC_IS_CONNECTION(conn));
+
+    entry = g_hash_table_lookup(self->priv->members, conn);
+
+    if (entry == NULL) {
+        return;
+    }
+
+    ipc_manager_unwatch(self, entry);
+    g_queue_remove(self->priv->kicked, entry);
+    g_signal_handlers_disconnect_by_data(conn, self);
+
+    /* keeps the connection alive until it is attached again */
+    g_object_ref(conn);
+    g_hash_table_remove(self->priv->members, conn);
+    i3ipc_connection_attach(conn, NULL);
+    g_object_unref(conn);
+}
+
+/**
+ * i3ipc_connection_manager_get_connections:
+ * @self: An #i3ipcConnectionManager
+ *
+ * Returns: (transfer container) (element-type i3ipcConnection): the
+ * connections of the manager
+ */
+GList *i3ipc_connection_manager_get_connections(i3ipcConnectionManager *self) {
+    g_return_val_if_fail(I3IPC_IS_CONNECTION_MANAGER(self), NULL);
+
+    return g_hash_table_get_keys(self->priv->members);
+}
+
+/**
+ * i3ipc_connection_manager_subscribe:
+ * @self: An #i3ipcConnectionManager
+ * @events: The events to subscribe to
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Subscribes every connection of the manager to @events, and the connections
+ * that are added later as well. A connection that fails to subscribe does
+ * not keep the others from doing so. The manager only emits the events it
+ * subscribed to.
+ *
+ * Returns: TRUE when every connection subscribed
+ */
+gboolean i3ipc_connection_manager_subscribe(i3ipcConnectionManager *self, i3ipcEvent events,
+                                            GError **err) {
+    GError *tmp_error = NULL;
+    GHashTableIter iter;
+    i3ipcManagedConnection *entry;
+    i3ipcEvent added;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION_MANAGER(self), FALSE);
+    g_return_val_if_fail(err == NULL || *err == NULL, FALSE);
+
+    added = events & ~self->priv->subscriptions;
+    self->priv->subscriptions |= events;
+
+    g_hash_table_iter_init(&iter, self->priv->members);
+
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)) {
+        GError *conn_error = NULL;
+        i3ipcCommandReply *reply;
+
+        ipc_manager_forward(self, entry->conn, added);
+        reply = i3ipc_connection_subscribe(entry->conn, events, &conn_error);
+
+        if (reply != NULL) {
+            i3ipc_command_reply_free(reply);
+        }
+
+        if (conn_error == NULL) {
+            /* events that came in with the reply are buffered already */
+            ipc_manager_kick(self, entry);
+        } else if (tmp_error == NULL) {
+            tmp_error = conn_error;
+        } else {
+            g_error_free(conn_error);
+        }
+    }
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ */
+
+#ifndef __I3IPC_CONNECTION_MANAGER_H__
+#define __I3IPC_CONNECTION_MANAGER_H__
+
+#include <glib-object.h>
+
+#include "i3ipc-connection.h"
+
+/**
+ * SECTION: i3ipc-connection-manager
+ * @short_description: Events of many ipc instances from one source.
+ *
+ * Every #i3ipcConnection watches its own subscription socket from a
+ * #GMainContext. A program that talks to many instances of i3 at once, such
+ * as one per X display, can hand its connections to a manager instead. The
+ * manager watches all of their subscription sockets with a single epoll set
+ * from a single #GSource, and only dispatches the connections that have
+ * something to read.
+ *
+ * The events of every connection are emitted on the manager too, along with
+ * the connection they came from, so one handler can serve all of them.
+ */
+
+#define I3IPC_TYPE_CONNECTION_MANAGER (i3ipc_connection_manager_get_type())
+#define I3IPC_CONNECTION_MANAGER(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), I3IPC_TYPE_CONNECTION_MANAGER, i3ipcConnectionManager))
+#define I3IPC_IS_CONNECTION_MANAGER(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE((obj), I3IPC_TYPE_CONNECTION_MANAGER))
+#define I3IPC_CONNECTION_MANAGER_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST((klass), I3IPC_TYPE_CONNECTION_MANAGER, i3ipcConnectionManagerClass))
+#define I3IPC_IS_CONNECTION_MANAGER_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE((klass), I3IPC_TYPE_CONNECTION_MANAGER))
+#define I3IPC_CONNECTION_MANAGER_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS((obj), I3IPC_TYPE_CONNECTION_MANAGER, i3ipcConnectionManagerClass))
+
+typedef struct _i3ipcConnectionManager i3ipcConnectionManager;
+typedef struct _i3ipcConnectionManagerClass i3ipcConnectionManagerClass;
+typedef struct _i3ipcConnectionManagerPrivate i3ipcConnectionManagerPrivate;
+
+struct _i3ipcConnectionManager {
+    GObject parent_instance;
+
+    i3ipcConnectionManagerPrivate *priv;
+};
+
+struct _i3ipcConnectionManagerClass {
+    GObjectClass parent_class;
+};
+
+GType i3ipc_connection_manager_get_type(void);
+
+i3ipcConnectionManager *i3ipc_connection_manager_new(GMainContext *context);
+
+gboolean i3ipc_connection_manager_add(i3ipcConnectionManager *self, i3ipcConnection *conn,
+                                      GError **err);
+
+i3ipcConnection *i3ipc_connection_manager_add_socket(i3ipcConnectionManager *self,
+                                                     const gchar *socket_path, GError **err);
+
+void i3ipc_connection_manager_remove(i3ipcConnectionManager *self, i3ipcConnection *conn);
+
+GList *i3ipc_connection_manager_get_connections(i3ipcConnectionManager *self);
+
+gboolean i3ipc_connection_manager_subscribe(i3ipcConnectionManager *self, i3ipcEvent events,
+                                            GError **err);
+
+#endif /* __I3IPC_CONNECTION_MANAGER_H__ */
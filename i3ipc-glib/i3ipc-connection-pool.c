@@ -0,0 +1,458 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ */
+
+#include "i3ipc-connection-pool.h"
+
+#include <gio/gio.h>
+
+enum {
+    PROP_0,
+
+    PROP_SIZE,
+
+    N_PROPERTIES
+};
+
+static GParamSpec *obj_properties[N_PROPERTIES] = {
+    NULL,
+};
+
+struct _i3ipcConnectionPoolPrivate {
+    GPtrArray *members;
+    /* the number of requests in flight on each member */
+    guint *in_flight;
+    GMutex lock;
+};
+
+/*
+ * The queries i3ipc_connection_pool_get_state() makes, one per member.
+ */
+typedef enum {
+    POOL_QUERY_TREE,
+    POOL_QUERY_WORKSPACES,
+    POOL_QUERY_OUTPUTS,
+    POOL_QUERY_MARKS,
+    POOL_N_QUERIES
+} i3ipcPoolQuery;
+
+/*
+ * What i3ipc_connection_pool_get_state() collects while the queries run.
+ */
+typedef struct {
+    guint n_pending;
+    gpointer results[POOL_N_QUERIES];
+    GError *error;
+} i3ipcPoolState;
+
+G_DEFINE_TYPE_WITH_PRIVATE(i3ipcConnectionPool, i3ipc_connection_pool, G_TYPE_OBJECT);
+
+static void i3ipc_connection_pool_get_property(GObject *object, guint property_id, GValue *value,
+                                               GParamSpec *pspec) {
+    i3ipcConnectionPool *self = I3IPC_CONNECTION_POOL(object);
+
+    switch (property_id) {
+    case PROP_SIZE:
+        g_value_set_uint(value, self->priv->members->len);
+        break;
+
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void i3ipc_connection_pool_finalize(GObject *gobject) {
+    i3ipcConnectionPool *self = I3IPC_CONNECTION_POOL(gobject);
+
+    g_ptr_array_unref(self->priv->members);
+    g_free(self->priv->in_flight);
+    g_mutex_clear(&self->priv->lock);
+
+    G_OBJECT_CLASS(i3ipc_connection_pool_parent_class)->finalize(gobject);
+}
+
+static void i3ipc_connection_pool_class_init(i3ipcConnectionPoolClass *klass) {
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->get_property = i3ipc_connection_pool_get_property;
+    gobject_class->finalize = i3ipc_connection_pool_finalize;
+
+    obj_properties[PROP_SIZE] =
+        g_param_spec_uint("size", "Pool size", "The number of connections in the pool", 0,
+                          G_MAXUINT, 0, G_PARAM_READABLE);
+
+    g_object_class_install_properties(gobject_class, N_PROPERTIES, obj_properties);
+}
+
+static void i3ipc_connection_pool_init(i3ipcConnectionPool *self) {
+    self->priv = i3ipc_connection_pool_get_instance_private(self);
+    self->priv->members = g_ptr_array_new_with_free_func(g_object_unref);
+    g_mutex_init(&self->priv->lock);
+}
+
+/*
+ * Makes a pool of @size connections out of @first and new connections through
+ * its transport. Takes the reference to @first.
+ */
+static i3ipcConnectionPool *ipc_pool_new(i3ipcConnection *first, guint size, GError **err) {
+    i3ipcConnectionPool *self;
+    i3ipcTransport *transport;
+
+    self = g_object_new(I3IPC_TYPE_CONNECTION_POOL, NULL);
+    self->priv->in_flight = g_new0(guint, size);
+    g_ptr_array_add(self->priv->members, first);
+
+    g_object_get(first, "transport", &transport, NULL);
+
+    while (self->priv->members->len < size) {
+        i3ipcConnection *conn = i3ipc_connection_new_with_transport(transport, err);
+
+        if (conn == NULL) {
+            g_object_unref(transport);
+            g_object_unref(self);
+            return NULL;
+        }
+
+        g_ptr_array_add(self->priv->members, conn);
+    }
+
+    g_object_unref(transport);
+
+    return self;
+}
+
+/**
+ * i3ipc_connection_pool_new:
+ * @socket_path: (allow-none): the path of the socket to connect to
+ * @size: the number of connections in the pool
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Opens @size connections to the ipc. The socket is looked up once, as
+ * i3ipc_connection_new() does, and all the connections use it.
+ *
+ * Returns: (transfer full): a new #i3ipcConnectionPool, or NULL on failure
+ */
+i3ipcConnectionPool *i3ipc_connection_pool_new(const gchar *socket_path, guint size, GError **err) {
+    i3ipcConnection *first;
+
+    g_return_val_if_fail(size > 0, NULL);
+
+    first = i3ipc_connection_new(socket_path, err);
+
+    if (first == NULL) {
+        return NULL;
+    }
+
+    return ipc_pool_new(first, size, err);
+}
+
+/**
+ * i3ipc_connection_pool_new_with_transport:
+ * @transport: the #i3ipcTransport that opens the sockets
+ * @size: the number of connections in the pool
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Opens @size connections to the ipc through @transport.
+ *
+ * Returns: (transfer full): a new #i3ipcConnectionPool, or NULL on failure
+ */
+i3ipcConnectionPool *i3ipc_connection_pool_new_with_transport(i3ipcTransport *transport, guint size,
+                                                              GError **err) {
+    i3ipcConnection *first;
+
+    g_return_val_if_fail(I3IPC_IS_TRANSPORT(transport), NULL);
+    g_return_val_if_fail(size > 0, NULL);
+
+    first = i3ipc_connection_new_with_transport(transport, err);
+
+    if (first == NULL) {
+        return NULL;
+    }
+
+    return ipc_pool_new(first, size, err);
+}
+
+/**
+ * i3ipc_connection_pool_get_size:
+ * @self: An #i3ipcConnectionPool
+ *
+ * Returns: the number of connections in the pool
+ */
+guint i3ipc_connection_pool_get_size(i3ipcConnectionPool *self) {
+    g_return_val_if_fail(I3IPC_IS_CONNECTION_POOL(self), 0);
+
+    return self->priv->members->len;
+}
+
+/**
+ * i3ipc_connection_pool_acquire:
+ * @self: An #i3ipcConnectionPool
+ *
+ * Picks the connection of the pool with the fewest requests in flight, which
+ * is an idle one whenever there is one. It counts as busy until it is given
+ * back with i3ipc_connection_pool_release().
+ *
+ * Returns: (transfer full): a connection of the pool
+ */
+i3ipcConnection *i3ipc_connection_pool_acquire(i3ipcConnectionPool *self) {
+    guint best = 0;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION_POOL(self), NULL);
+
+    g_mutex_lock(&self->priv->lock);
+
+    for (guint i = 1; i < self->priv->members->len && self->priv->in_flight[best] > 0; i += 1) {
+        if (self->priv->in_flight[i] < self->priv->in_flight[best]) {
+            best = i;
+        }
+    }
+
+    self->priv->in_flight[best] += 1;
+
+    g_mutex_unlock(&self->priv->lock);
+
+    return g_object_ref(g_ptr_array_index(self->priv->members, best));
+}
+
+/**
+ * i3ipc_connection_pool_release:
+ * @self: An #i3ipcConnectionPool
+ * @conn: (transfer full): a connection returned by i3ipc_connection_pool_acquire()
+ *
+ * Gives a connection back to the pool once its request is done.
+ */
+void i3ipc_connection_pool_release(i3ipcConnectionPool *self, i3ipcConnection *conn) {
+    guint index = 0;
+
+    g_return_if_fail(I3IPC_IS_CONNECTION_POOL(self));
+    g_return_if_fail(I3IPC_IS_CONNECTION(conn));
+
+    while (index < self->priv->members->len &&
+           g_ptr_array_index(self->priv->members, index) != conn) {
+        index += 1;
+    }
+
+    if (index == self->priv->members->len) {
+        g_warning("the connection does not belong to the pool\n");
+        return;
+    }
+
+    g_mutex_lock(&self->priv->lock);
+
+    if (self->priv->in_flight[index] > 0) {
+        self->priv->in_flight[index] -= 1;
+    }
+
+    g_mutex_unlock(&self->priv->lock);
+
+    g_object_unref(conn);
+}
+
+/**
+ * i3ipc_connection_pool_message:
+ * @self: An #i3ipcConnectionPool
+ * @message_type: The type of message to send to i3
+ * @payload: (allow-none): The body of the command
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Sends a message synchronously on an idle connection of the pool, like
+ * i3ipc_connection_message() does.
+ *
+ * Returns: (transfer full): The reply of the ipc as a string
+ */
+gchar *i3ipc_connection_pool_message(i3ipcConnectionPool *self, i3ipcMessageType message_type,
+                                     const gchar *payload, GError **err) {
+    i3ipcConnection *conn;
+    gchar *retval;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION_POOL(self), NULL);
+
+    conn = i3ipc_connection_pool_acquire(self);
+    retval = i3ipc_connection_message(conn, message_type, payload, err);
+    i3ipc_connection_pool_release(self, conn);
+
+    return retval;
+}
+
+static void ipc_pool_free_result(i3ipcPoolQuery query, gpointer result) {
+    switch (query) {
+    case POOL_QUERY_TREE:
+        if (result != NULL) {
+            g_object_unref(result);
+        }
+        break;
+
+    case POOL_QUERY_WORKSPACES:
+        g_slist_free_full(result, (GDestroyNotify)i3ipc_workspace_reply_free);
+        break;
+
+    case POOL_QUERY_OUTPUTS:
+        g_slist_free_full(result, (GDestroyNotify)i3ipc_output_reply_free);
+        break;
+
+    case POOL_QUERY_MARKS:
+        g_slist_free_full(result, g_free);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * Runs one of the queries of i3ipc_connection_pool_get_state() in a worker
+ * thread, on a connection of its own. Parsing the reply happens there too.
+ */
+static void ipc_pool_query_thread(GTask *task, gpointer source_object, gpointer task_data,
+                                  GCancellable *cancellable) {
+    i3ipcConnectionPool *self = source_object;
+    i3ipcPoolQuery query = GPOINTER_TO_INT(task_data);
+    i3ipcConnection *conn = i3ipc_connection_pool_acquire(self);
+    GError *tmp_error = NULL;
+    gpointer result = NULL;
+
+    switch (query) {
+    case POOL_QUERY_TREE:
+        result = i3ipc_connection_get_tree(conn, &tmp_error);
+        break;
+
+    case POOL_QUERY_WORKSPACES:
+        result = i3ipc_connection_get_workspaces(conn, &tmp_error);
+        break;
+
+    case POOL_QUERY_OUTPUTS:
+        result = i3ipc_connection_get_outputs(conn, &tmp_error);
+        break;
+
+    case POOL_QUERY_MARKS:
+        result = i3ipc_connection_get_marks(conn, &tmp_error);
+        break;
+
+    default:
+        g_assert_not_reached();
+    }
+
+    i3ipc_connection_pool_release(self, conn);
+
+    if (tmp_error != NULL) {
+        ipc_pool_free_result(query, result);
+        g_task_return_error(task, tmp_error);
+        return;
+    }
+
+    g_task_return_pointer(task, result, NULL);
+}
+
+static void ipc_pool_on_query_done(GObject *source_object, GAsyncResult *result,
+                                   gpointer user_data) {
+    i3ipcPoolState *state = user_data;
+    i3ipcPoolQuery query = GPOINTER_TO_INT(g_task_get_task_data(G_TASK(result)));
+    GError *tmp_error = NULL;
+
+    state->results[query] = g_task_propagate_pointer(G_TASK(result), &tmp_error);
+
+    if (tmp_error != NULL) {
+        if (state->error == NULL) {
+            state->error = tmp_error;
+        } else {
+            g_error_free(tmp_error);
+        }
+    }
+
+    state->n_pending -= 1;
+}
+
+/**
+ * i3ipc_connection_pool_get_state:
+ * @self: An #i3ipcConnectionPool
+ * @tree: (out) (transfer full) (optional): return location for the layout tree
+ * @workspaces: (out) (transfer full) (optional) (element-type i3ipcWorkspaceReply):
+ * return location for the workspaces
+ * @outputs: (out) (transfer full) (optional) (element-type i3ipcOutputReply):
+ * return location for the outputs
+ * @marks: (out) (transfer full) (optional) (element-type utf8): return location
+ * for the marks
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Gets the tree, the workspaces, the outputs and the marks at once. Every
+ * query that is asked for goes out on its own connection of the pool and its
+ * reply is parsed in its own thread, so the whole call takes about as long as
+ * the slowest of them instead of all of them together.
+ *
+ * Returns: TRUE when all of the replies arrived, FALSE and nothing in the
+ * return locations when one of the queries failed
+ */
+gboolean i3ipc_connection_pool_get_state(i3ipcConnectionPool *self, i3ipcCon **tree,
+                                         GSList **workspaces, GSList **outputs, GSList **marks,
+                                         GError **err) {
+    gpointer *locations[POOL_N_QUERIES] = {(gpointer *)tree, (gpointer *)workspaces,
+                                           (gpointer *)outputs, (gpointer *)marks};
+    i3ipcPoolState state = {0};
+    GMainContext *context;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION_POOL(self), FALSE);
+    g_return_val_if_fail(err == NULL || *err == NULL, FALSE);
+
+    /* the results come back here while this thread waits for them */
+    context = g_main_context_new();
+    g_main_context_push_thread_default(context);
+
+    for (gint query = 0; query < POOL_N_QUERIES; query += 1) {
+        GTask *task;
+
+        if (locations[query] == NULL) {
+            continue;
+        }
+
+        task = g_task_new(self, NULL, ipc_pool_on_query_done, &state);
+        g_task_set_source_tag(task, i3ipc_connection_pool_get_state);
+        g_task_set_task_data(task, GINT_TO_POINTER(query), NULL);
+        g_task_run_in_thread(task, ipc_pool_query_thread);
+        g_object_unref(task);
+
+        state.n_pending += 1;
+    }
+
+    while (state.n_pending > 0) {
+        g_main_context_iteration(context, TRUE);
+    }
+
+    g_main_context_pop_thread_default(context);
+    g_main_context_unref(context);
+
+    for (gint query = 0; query < POOL_N_QUERIES; query += 1) {
+        if (locations[query] == NULL) {
+            continue;
+        }
+
+        if (state.error != NULL) {
+            ipc_pool_free_result(query, state.results[query]);
+            *locations[query] = NULL;
+        } else {
+            *locations[query] = state.results[query];
+        }
+    }
+
+    if (state.error != NULL) {
+        g_propagate_error(err, state.error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ */
+
+#ifndef __I3IPC_CONNECTION_POOL_H__
+#define __I3IPC_CONNECTION_POOL_H__
+
+#include <glib-object.h>
+
+#include "i3ipc-connection.h"
+
+/**
+ * SECTION: i3ipc-connection-pool
+ * @short_description: Several command sockets to the same ipc.
+ *
+ * An #i3ipcConnection answers its requests one after the other, so a slow
+ * query like the tree holds up every query behind it. A pool keeps a number
+ * of connections to the same ipc and hands out the one with the fewest
+ * requests in flight, so queries from different parts of a program do not
+ * wait for each other.
+ *
+ * The connections of a pool never subscribe to events unless they are asked
+ * to, so they only cost a socket each.
+ */
+
+#define I3IPC_TYPE_CONNECTION_POOL (i3ipc_connection_pool_get_type())
+#define I3IPC_CONNECTION_POOL(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), I3IPC_TYPE_CONNECTION_POOL, i3ipcConnectionPool))
+#define I3IPC_IS_CONNECTION_POOL(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE((obj), I3IPC_TYPE_CONNECTION_POOL))
+#define I3IPC_CONNECTION_POOL_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST((klass), I3IPC_TYPE_CONNECTION_POOL, i3ipcConnectionPoolClass))
+#define I3IPC_IS_CONNECTION_POOL_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE((klass), I3IPC_TYPE_CONNECTION_POOL))
+#define I3IPC_CONNECTION_POOL_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS((obj), I3IPC_TYPE_CONNECTION_POOL, i3ipcConnectionPoolClass))
+
+typedef struct _i3ipcConnectionPool i3ipcConnectionPool;
+typedef struct _i3ipcConnectionPoolClass i3ipcConnectionPoolClass;
+typedef struct _i3ipcConnectionPoolPrivate i3ipcConnectionPoolPrivate;
+
+struct _i3ipcConnectionPool {
+    GObject parent_instance;
+
+    i3ipcConnectionPoolPrivate *priv;
+};
+
+struct _i3ipcConnectionPoolClass {
+    GObjectClass parent_class;
+};
+
+GType i3ipc_connection_pool_get_type(void);
+
+i3ipcConnectionPool *i3ipc_connection_pool_new(const gchar *socket_path, guint size, GError **err);
+
+i3ipcConnectionPool *i3ipc_connection_pool_new_with_transport(i3ipcTransport *transport, guint size,
+                                                              GError **err);
+
+guint i3ipc_connection_pool_get_size(i3ipcConnectionPool *self);
+
+i3ipcConnection *i3ipc_connection_pool_acquire(i3ipcConnectionPool *self);
+
+void i3ipc_connection_pool_release(i3ipcConnectionPool *self, i3ipcConnection *conn);
+
+gchar *i3ipc_connection_pool_message(i3ipcConnectionPool *self, i3ipcMessageType message_type,
+                                     const gchar *payload, GError **err);
+
+gboolean i3ipc_connection_pool_get_state(i3ipcConnectionPool *self, i3ipcCon **tree,
+                                         GSList **workspaces, GSList **outputs, GSList **marks,
+                                         GError **err);
+
+#endif /* __I3IPC_CONNECTION_POOL_H__ */
@@ -19,20 +19,47 @@
 
 #include "i3ipc-connection.h"
 
-#include <fcntl.h>
 #include <gio/gio.h>
 #include <glib-object.h>
+#include <glib-unix.h>
 #include <json-glib/json-glib.h>
+#include <limits.h>
 #include <sys/errno.h>
 #include <sys/socket.h>
-#include <sys/un.h>
-#include <xcb/xcb.h>
+#include <sys/uio.h>
 
 #include "i3ipc-con-private.h"
+#include "i3ipc-discovery-private.h"
 #include "i3ipc-enum-types.h"
 #include "i3ipc-event-types.h"
+#include "i3ipc-event-types-private.h"
 #include "i3ipc-reply-types.h"
 
+#ifdef I3IPC_HAVE_IO_URING
+#include "i3ipc-uring-private.h"
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* the bounds of the delay between two attempts to reconnect, in ms */
+#define I3IPC_RECONNECT_MIN_DELAY 10
+#define I3IPC_RECONNECT_MAX_DELAY 2000
+
+/* how long a synchronous message waits for the ipc to come back, in ms */
+#define I3IPC_RECONNECT_SYNC_TIMEOUT 1000
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* set in the type of a message that is an event */
+#define I3IPC_EVENT_BIT (1u << 31)
+
+/* the event types, which are the bits of #i3ipcEvent and the first signals */
+#define I3IPC_N_EVENT_TYPES 6
+
 typedef struct i3_ipc_header {
     /* 6 = strlen(I3_IPC_MAGIC) */
     char magic[6];
@@ -46,6 +73,11 @@ enum {
     PROP_SUBSCRIPTIONS,
     PROP_SOCKET_PATH,
     PROP_CONNECTED,
+    PROP_EVENT_PRIORITY,
+    PROP_TRANSPORT,
+    PROP_AUTO_RECONNECT,
+    PROP_TIMEOUT,
+    PROP_EVENT_THREAD,
 
     N_PROPERTIES
 };
@@ -54,797 +86,4153 @@ static GParamSpec *obj_properties[N_PROPERTIES] = {
     NULL,
 };
 
-enum { WORKSPACE, OUTPUT, MODE, WINDOW, BARCONFIG_UPDATE, BINDING, IPC_SHUTDOWN, LAST_SIGNAL };
+enum {
+    WORKSPACE,
+    OUTPUT,
+    MODE,
+    WINDOW,
+    BARCONFIG_UPDATE,
+    BINDING,
+    IPC_SHUTDOWN,
+    RECONNECTED,
+    EVENTS,
+    LAST_SIGNAL
+};
 
 static guint connection_signals[LAST_SIGNAL] = {0};
 
+/*
+ * Accumulates the bytes read from a socket and splits them into complete ipc
+ * messages.
+ */
+typedef struct {
+    GByteArray *buf;
+    gsize offset;
+} i3ipcFramer;
+
+/*
+ * A request on the command channel that is waiting for its reply. i3 answers
+ * requests in the order they were sent, so these are kept in a queue.
+ *
+ * The queue holds a reference, and so does a synchronous caller until it got
+ * its reply or gave up. The state and the reply are protected by the lock of
+ * the connection, the task is taken out atomically.
+ */
+typedef struct {
+    gint ref_count;
+    uint32_t message_type;
+    gboolean sync;
+    gboolean done;
+    gchar *reply;
+    gsize reply_length;
+    GError *error;
+    GTask *task;
+    GSource *cancel_source;
+} i3ipcPendingReply;
+
+/*
+ * A command socket with the requests that wait for their replies on it.
+ * Messages go out under the send lock of the lane, and one thread at a time
+ * reads the replies. The rest is protected by the lock of the connection.
+ */
+typedef struct {
+    GIOChannel *channel;
+    i3ipcFramer framer;
+    GQueue *pending;
+    GSource *source;
+    GMainContext *parked_context;
+    gboolean reading;
+    GMutex send_lock;
+} i3ipcLane;
+
+/*
+ * An event that was decoded and waits to be emitted. The event thread pushes
+ * them on a stack that is linked through @next.
+ */
+typedef struct _i3ipcQueuedEvent {
+    struct _i3ipcQueuedEvent *next;
+    guint signal;
+    GQuark detail;
+    gpointer event;
+} i3ipcQueuedEvent;
+
+typedef enum {
+    IPC_INIT_NONE,
+    IPC_INIT_RUNNING,
+    IPC_INIT_DONE,
+} i3ipcInitState;
+
 struct _i3ipcConnectionPrivate {
     i3ipcEvent subscriptions;
     gchar *socket_path;
+    i3ipcTransport *transport;
     gboolean connected;
+    i3ipcInitState init_state;
     GError *init_error;
     GMainLoop *main_loop;
-    GIOChannel *cmd_channel;
+    i3ipcLane cmd_lane;
+    i3ipcLane high_lane;
     GIOChannel *sub_channel;
+    i3ipcFramer sub_framer;
+    gboolean sub_reading;
+    GMutex lock;
+    GCond reply_cond;
+    GMutex parser_lock;
+    JsonParser *reply_parser;
+    JsonParser *event_parser;
+    GSource *sub_source;
+    GMainContext *events_context;
+    gboolean events_detached;
+    gboolean auto_reconnect;
+    gboolean reconnecting;
+    GRecMutex reconnect_lock;
+    guint generation;
+    gint timeout;
+    guint sub_replies_abandoned;
+    GSource *reconnect_source;
+    guint reconnect_delay;
+    gint64 disconnected_at;
+    gint event_priority;
+    gboolean event_thread;
+    GThread *event_reader;
+    GCancellable *event_reader_cancellable;
+    GMainContext *event_reader_context;
+    gboolean event_reader_running;
+    gint event_reader_failed;
+    i3ipcQueuedEvent *event_stack;
+    GQueue event_backlog;
+    GQueue sub_replies;
+    gint event_handlers[I3IPC_N_EVENT_TYPES];
+    i3ipcEvent narrowable;
+    GSource *narrow_source;
+    GPtrArray *coalesce_policies;
+    GPtrArray *batch;
+#ifdef I3IPC_HAVE_IO_URING
+    i3ipcUring *uring;
+    GMutex uring_lock;
+#endif
 };
 
+/*
+ * Reads and dispatches the events of a connection from whatever context it is
+ * attached to.
+ */
+typedef struct {
+    GSource source;
+    i3ipcConnection *conn;
+    gpointer fd_tag;
+} i3ipcEventSource;
+
 static void i3ipc_connection_initable_iface_init(GInitableIface *iface);
+static void i3ipc_connection_async_initable_iface_init(GAsyncInitableIface *iface);
+static void ipc_attach_events(i3ipcConnection *self, GMainContext *context);
+static void ipc_event_reader_stop(i3ipcConnection *self);
 
 G_DEFINE_TYPE_WITH_CODE(i3ipcConnection, i3ipc_connection, G_TYPE_OBJECT,
                         G_ADD_PRIVATE(i3ipcConnection)
                             G_IMPLEMENT_INTERFACE(G_TYPE_INITABLE,
-                                                  i3ipc_connection_initable_iface_init));
+                                                  i3ipc_connection_initable_iface_init)
+                                G_IMPLEMENT_INTERFACE(G_TYPE_ASYNC_INITABLE,
+                                                      i3ipc_connection_async_initable_iface_init));
 
-static void i3ipc_connection_set_property(GObject *object, guint property_id, const GValue *value,
-                                          GParamSpec *pspec) {
-    i3ipcConnection *self = I3IPC_CONNECTION(object);
+static void ipc_framer_init(i3ipcFramer *framer) {
+    framer->buf = g_byte_array_new();
+    framer->offset = 0;
+}
 
-    switch (property_id) {
-    case PROP_SOCKET_PATH:
-        g_free(self->priv->socket_path);
-        self->priv->socket_path = g_value_dup_string(value);
-        break;
+static void ipc_framer_clear(i3ipcFramer *framer) {
+    g_clear_pointer(&framer->buf, g_byte_array_unref);
+    framer->offset = 0;
+}
 
-    default:
-        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
-        break;
+static void ipc_lane_init(i3ipcLane *lane) {
+    ipc_framer_init(&lane->framer);
+    lane->pending = g_queue_new();
+    g_mutex_init(&lane->send_lock);
+}
+
+/*
+ * Drops the messages that were already consumed from the buffer.
+ */
+static void ipc_framer_compact(i3ipcFramer *framer) {
+    if (framer->offset > 0) {
+        g_byte_array_remove_range(framer->buf, 0, framer->offset);
+        framer->offset = 0;
     }
 }
 
-static void i3ipc_connection_get_property(GObject *object, guint property_id, GValue *value,
-                                          GParamSpec *pspec) {
-    i3ipcConnection *self = I3IPC_CONNECTION(object);
+/*
+ * Reads whatever is available on the socket into the framer without
+ * blocking. Returns G_IO_STATUS_AGAIN when there was nothing to read.
+ */
+static GIOStatus ipc_framer_fill(i3ipcFramer *framer, int fd, GError **err) {
+    const gsize chunk_size = 4096;
+    GIOStatus status = G_IO_STATUS_AGAIN;
 
-    switch (property_id) {
-    case PROP_SUBSCRIPTIONS:
-        g_value_set_flags(value, self->priv->subscriptions);
-        break;
+    ipc_framer_compact(framer);
 
-    case PROP_SOCKET_PATH:
-        g_value_set_string(value, self->priv->socket_path);
-        break;
+    while (TRUE) {
+        guint len = framer->buf->len;
+        g_byte_array_set_size(framer->buf, len + chunk_size);
 
-    case PROP_CONNECTED:
-        g_value_set_boolean(value, self->priv->connected);
-        break;
+        ssize_t n = recv(fd, framer->buf->data + len, chunk_size, MSG_DONTWAIT);
 
-    default:
-        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
-        break;
-    }
-}
+        g_byte_array_set_size(framer->buf, len + MAX(n, 0));
 
-static void i3ipc_connection_dispose(GObject *gobject) {
-    i3ipcConnection *self = I3IPC_CONNECTION(gobject);
+        if (n > 0) {
+            status = G_IO_STATUS_NORMAL;
 
-    g_clear_error(&self->priv->init_error);
+            if ((gsize)n < chunk_size) {
+                break;
+            }
 
-    if (self->priv->connected) {
-        g_io_channel_shutdown(self->priv->cmd_channel, TRUE, NULL);
-        g_io_channel_shutdown(self->priv->sub_channel, TRUE, NULL);
-        self->priv->sub_channel = (g_io_channel_unref(self->priv->sub_channel), NULL);
-        self->priv->cmd_channel = (g_io_channel_unref(self->priv->cmd_channel), NULL);
+            continue;
+        }
+
+        if (n == 0) {
+            /* report the data we got first, the next read will see the eof */
+            return (status == G_IO_STATUS_NORMAL ? status : G_IO_STATUS_EOF);
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno), "Could not read from i3 (%s)",
+                    strerror(errno));
+        return G_IO_STATUS_ERROR;
     }
 
-    G_OBJECT_CLASS(i3ipc_connection_parent_class)->dispose(gobject);
+    return status;
 }
 
-static void i3ipc_connection_finalize(GObject *gobject) {
-    i3ipcConnection *self = I3IPC_CONNECTION(gobject);
+/*
+ * Takes the next complete message out of the framer. The payload points into
+ * the framer buffer and is only valid until the next ipc_framer_fill().
+ * Returns FALSE when no complete message is buffered or the stream is corrupt.
+ */
+static gboolean ipc_framer_next(i3ipcFramer *framer, uint32_t *message_type, const gchar **payload,
+                                uint32_t *size, GError **err) {
+    i3_ipc_header_t header;
+    gsize available = framer->buf->len - framer->offset;
+    const guint8 *walk = framer->buf->data + framer->offset;
 
-    g_free(self->priv->socket_path);
+    if (available < sizeof(i3_ipc_header_t)) {
+        return FALSE;
+    }
 
-    G_OBJECT_CLASS(i3ipc_connection_parent_class)->finalize(gobject);
-}
+    memcpy(&header, walk, sizeof(i3_ipc_header_t));
 
-static void i3ipc_connected_constructed(GObject *gobject) {
-    i3ipcConnection *self = I3IPC_CONNECTION(gobject);
+    if (memcmp(header.magic, I3IPC_MAGIC, strlen(I3IPC_MAGIC)) != 0) {
+        /* TODO i3ipc custom errors */
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Invalid magic in reply");
+        return FALSE;
+    }
 
-    self->priv->init_error = NULL;
+    if (available - sizeof(i3_ipc_header_t) < header.size) {
+        return FALSE;
+    }
 
-    g_initable_init((GInitable *)self, NULL, &self->priv->init_error);
+    *message_type = header.type;
+    *payload = (const gchar *)walk + sizeof(i3_ipc_header_t);
+    *size = header.size;
+    framer->offset += sizeof(i3_ipc_header_t) + header.size;
 
-    G_OBJECT_CLASS(i3ipc_connection_parent_class)->constructed(gobject);
+    return TRUE;
 }
 
-static void i3ipc_connection_class_init(i3ipcConnectionClass *klass) {
-    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+/*
+ * Whether the framer holds a complete message, or a header that is corrupt.
+ */
+static gboolean ipc_framer_has_message(i3ipcFramer *framer) {
+    i3_ipc_header_t header;
+    gsize available = framer->buf->len - framer->offset;
 
-    gobject_class->set_property = i3ipc_connection_set_property;
-    gobject_class->get_property = i3ipc_connection_get_property;
-    gobject_class->dispose = i3ipc_connection_dispose;
-    gobject_class->finalize = i3ipc_connection_finalize;
-    gobject_class->constructed = i3ipc_connected_constructed;
+    if (available < sizeof(i3_ipc_header_t)) {
+        return FALSE;
+    }
 
-    obj_properties[PROP_SUBSCRIPTIONS] =
-        g_param_spec_flags("subscriptions", "Connection subscriptions",
-                           "The subscriptions this connection is subscribed to", I3IPC_TYPE_EVENT,
-                           0, G_PARAM_READABLE);
+    memcpy(&header, framer->buf->data + framer->offset, sizeof(i3_ipc_header_t));
 
-    obj_properties[PROP_SOCKET_PATH] = g_param_spec_string(
-        "socket-path", "Connection socket path",
-        "The path of the unix socket the connection is connected to", NULL, /* default */
-        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    return (memcmp(header.magic, I3IPC_MAGIC, strlen(I3IPC_MAGIC)) != 0 ||
+            available - sizeof(i3_ipc_header_t) >= header.size);
+}
 
-    obj_properties[PROP_CONNECTED] = g_param_spec_boolean(
-        "connected", "Connection connected",
-        "Whether or not a connection has been established to the ipc", FALSE, G_PARAM_READABLE);
+/*
+ * Takes the first reply that is not an event out of the framer and leaves the
+ * events around it in place to be dispatched later. Returns NULL when no
+ * complete reply is buffered.
+ */
+static gchar *ipc_framer_take_reply(i3ipcFramer *framer, GError **err) {
+    i3_ipc_header_t header;
+    gsize pos = framer->offset;
+    gchar *reply;
 
-    g_object_class_install_properties(gobject_class, N_PROPERTIES, obj_properties);
+    while (framer->buf->len - pos >= sizeof(i3_ipc_header_t)) {
+        memcpy(&header, framer->buf->data + pos, sizeof(i3_ipc_header_t));
 
-    /**
-     * i3ipcConnection::workspace:
-     * @self: the #i3ipcConnection on which the signal was emitted
-     * @e: The workspace event object
-     *
-     * Sent when the user switches to a different workspace, when a new workspace
-     * is initialized or when a workspace is removed (because the last client
-     * vanished).
-     */
-    connection_signals[WORKSPACE] =
-        g_signal_new("workspace",                           /* signal_name */
-                     I3IPC_TYPE_CONNECTION,                 /* itype */
-                     G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED, /* signal_flags */
-                     0,                                     /* class_offset */
-                     NULL,                                  /* accumulator */
-                     NULL,                                  /* accu_data */
-                     g_cclosure_marshal_VOID__BOXED,        /* c_marshaller */
-                     G_TYPE_NONE,                           /* return_type */
-                     1, I3IPC_TYPE_WORKSPACE_EVENT);        /* n_params */
+        if (memcmp(header.magic, I3IPC_MAGIC, strlen(I3IPC_MAGIC)) != 0) {
+            /* TODO i3ipc custom errors */
+            g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                "Invalid magic in reply");
+            return NULL;
+        }
 
-    /**
-     * i3ipcConnection::output:
-     * @self: the #i3ipcConnection on which the signal was emitted
-     * @e: The output event object
-     *
-     * Sent when RandR issues a change notification (of either screens, outputs,
-     * CRTCs or output properties).
-     */
-    connection_signals[OUTPUT] =
-        g_signal_new("output",                               /* signal_name */
-                     I3IPC_TYPE_CONNECTION,                  /* itype */
-                     G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
-                     0,                                      /* class_offset */
-                     NULL,                                   /* accumulator */
-                     NULL,                                   /* accu_data */
-                     g_cclosure_marshal_VOID__BOXED,         /* c_marshaller */
-                     G_TYPE_NONE,                            /* return_type */
-                     1, I3IPC_TYPE_GENERIC_EVENT);           /* n_params */
+        if (framer->buf->len - pos - sizeof(i3_ipc_header_t) < header.size) {
+            return NULL;
+        }
 
-    /**
-     * i3ipcConnection::mode:
-     * @self: the #i3ipcConnection on which the signal was emitted
-     * @e: The mode event object
-     *
-     * Sent whenever i3 changes its binding mode.
-     */
-    connection_signals[MODE] =
-        g_signal_new("mode",                                 /* signal_name */
-                     I3IPC_TYPE_CONNECTION,                  /* itype */
-                     G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
-                     0,                                      /* class_offset */
-                     NULL,                                   /* accumulator */
-                     NULL,                                   /* accu_data */
-                     g_cclosure_marshal_VOID__BOXED,         /* c_marshaller */
-                     G_TYPE_NONE,                            /* return_type */
-                     1, I3IPC_TYPE_GENERIC_EVENT);           /* n_params */
+        if (!(header.type & I3IPC_EVENT_BIT)) {
+            reply = g_strndup((const gchar *)framer->buf->data + pos + sizeof(i3_ipc_header_t),
+                              header.size);
+            g_byte_array_remove_range(framer->buf, pos, sizeof(i3_ipc_header_t) + header.size);
+            return reply;
+        }
 
-    /**
-     * i3ipcConnection::window:
-     * @self: the #i3ipcConnection on which the signal was emitted
-     * @e: The window event object
-     *
-     * Sent when a client’s window is successfully reparented (that is when i3
-     * has finished fitting it into a container).
-     */
-    connection_signals[WINDOW] =
-        g_signal_new("window",                               /* signal_name */
-                     I3IPC_TYPE_CONNECTION,                  /* itype */
-                     G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
-                     0,                                      /* class_offset */
-                     NULL,                                   /* accumulator */
-                     NULL,                                   /* accu_data */
-                     g_cclosure_marshal_VOID__BOXED,         /* c_marshaller */
-                     G_TYPE_NONE,                            /* return_type */
-                     1, I3IPC_TYPE_WINDOW_EVENT);            /* n_params */
+        pos += sizeof(i3_ipc_header_t) + header.size;
+    }
 
-    /**
-     * i3ipcConnection::barconfig_update:
-     * @self: the #i3ipcConnection on which the signal was emitted
-     * @e: The barconfig_update event object
-     *
-     * Sent when the hidden_state or mode field in the barconfig of any bar
-     * instance was updated.
-     */
-    connection_signals[BARCONFIG_UPDATE] =
-        g_signal_new("barconfig_update",                    /* signal_name */
-                     I3IPC_TYPE_CONNECTION,                 /* itype */
-                     G_SIGNAL_RUN_FIRST,                    /* signal_flags */
-                     0,                                     /* class_offset */
-                     NULL,                                  /* accumulator */
-                     NULL,                                  /* accu_data */
-                     g_cclosure_marshal_VOID__BOXED,        /* c_marshaller */
-                     G_TYPE_NONE,                           /* return_type */
-                     1, I3IPC_TYPE_BARCONFIG_UPDATE_EVENT); /* n_params */
+    return NULL;
+}
 
-    /**
-     * i3ipcConnection::binding:
-     * @self: the #i3ipcConnection on which the signal was emitted
-     * @e: the binding event object
-     *
-     * Sent when a binding was triggered with the keyboard or mouse because of
-     * some user input.
-     */
-    connection_signals[BINDING] =
-        g_signal_new("binding",                              /* signal_name */
-                     I3IPC_TYPE_CONNECTION,                  /* itype */
-                     G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
-                     0,                                      /* class_offset */
-                     NULL,                                   /* accumulator */
-                     NULL,                                   /* accu_data */
-                     g_cclosure_marshal_VOID__BOXED,         /* c_marshaller */
-                     G_TYPE_NONE,                            /* return_type */
-                     1,                                      /* n_params */
-                     I3IPC_TYPE_BINDING_EVENT);
+static i3ipcPendingReply *ipc_pending_reply_new(uint32_t message_type, gboolean sync) {
+    i3ipcPendingReply *entry = g_slice_new0(i3ipcPendingReply);
 
-    /**
-     * i3ipcConnection::ipc_shutdown:
-     * @self: the #i3ipcConnection on which the signal was emitted
-     *
-     * Sent when the Connection receives notice that the ipc has shut down.
-     */
-    connection_signals[IPC_SHUTDOWN] =
-        g_signal_new("ipc_shutdown",                /* signal_name */
-                     I3IPC_TYPE_CONNECTION,         /* itype */
-                     G_SIGNAL_RUN_FIRST,            /* signal_flags */
-                     0,                             /* class_offset */
-                     NULL,                          /* accumulator */
-                     NULL,                          /* accu_data */
-                     g_cclosure_marshal_VOID__VOID, /* c_marshaller */
-                     G_TYPE_NONE,                   /* return_type */
-                     0);                            /* n_params */
+    /* the queue takes its own reference when the request is sent */
+    entry->ref_count = 1;
+    entry->message_type = message_type;
+    entry->sync = sync;
+
+    return entry;
 }
 
-static void i3ipc_connection_init(i3ipcConnection *self) {
-    self->priv = i3ipc_connection_get_instance_private(self);
+static i3ipcPendingReply *ipc_pending_reply_ref(i3ipcPendingReply *entry) {
+    g_atomic_int_inc(&entry->ref_count);
+
+    return entry;
 }
 
-/**
- * i3ipc_connection_new:
- * @socket_path: (allow-none): the path of the socket to connect to
- * @err: (allow-none): return location for a GError, or NULL
- *
- * Allocates a new #i3ipcConnection
+static void ipc_pending_reply_unref(gpointer data) {
+    i3ipcPendingReply *entry = data;
+
+    if (!g_atomic_int_dec_and_test(&entry->ref_count)) {
+        return;
+    }
+
+    if (entry->cancel_source != NULL) {
+        g_source_destroy(entry->cancel_source);
+        g_source_unref(entry->cancel_source);
+    }
+
+    g_clear_object(&entry->task);
+    g_free(entry->reply);
+    g_clear_error(&entry->error);
+    g_slice_free(i3ipcPendingReply, entry);
+}
+
+static void ipc_lane_clear(i3ipcLane *lane) {
+    g_clear_pointer(&lane->parked_context, g_main_context_unref);
+    g_queue_free_full(lane->pending, ipc_pending_reply_unref);
+    ipc_framer_clear(&lane->framer);
+    g_mutex_clear(&lane->send_lock);
+}
+
+/*
+ * Stores the reply (or the error) in an entry that was taken off the queue,
+ * with the lock held. A synchronous caller picks it up itself, so the
+ * reference of the queue is dropped right away. Other entries are added to
+ * @completed, to be finished once the lock is released.
+ */
+static void ipc_pending_reply_resolve(i3ipcPendingReply *entry, gchar *reply, GError *error,
+                                      GQueue *completed) {
+    entry->reply = reply;
+    entry->error = error;
+    entry->done = TRUE;
+
+    if (entry->sync) {
+        ipc_pending_reply_unref(entry);
+    } else {
+        g_queue_push_tail(completed, entry);
+    }
+}
+
+/*
+ * Takes the task out of an entry. The reader and the cancellable of the
+ * request race for it, and only the one that gets it returns it.
+ */
+static GTask *ipc_pending_reply_steal_task(i3ipcPendingReply *entry) {
+    GTask *task;
+
+    do {
+        task = g_atomic_pointer_get(&entry->task);
+    } while (task != NULL && !g_atomic_pointer_compare_and_exchange(&entry->task, task, NULL));
+
+    return task;
+}
+
+/*
+ * Hands the reply of an asynchronous request to its task, without the lock
+ * held since this may run the callback. Entries of requests that were
+ * cancelled only exist to swallow their reply.
+ */
+static void ipc_pending_reply_finish(i3ipcPendingReply *entry) {
+    GTask *task = ipc_pending_reply_steal_task(entry);
+
+    if (task != NULL) {
+        if (entry->error != NULL) {
+            g_task_return_error(task, entry->error);
+        } else {
+            g_task_return_pointer(task, entry->reply, g_free);
+        }
+
+        entry->error = NULL;
+        entry->reply = NULL;
+        g_object_unref(task);
+    }
+
+    if (entry->cancel_source != NULL) {
+        /* drops the reference of the source */
+        g_source_destroy(entry->cancel_source);
+        g_clear_pointer(&entry->cancel_source, g_source_unref);
+    }
+
+    ipc_pending_reply_unref(entry);
+}
+
+static void ipc_pending_reply_finish_all(GQueue *completed) {
+    i3ipcPendingReply *entry;
+
+    while ((entry = g_queue_pop_head(completed)) != NULL) {
+        ipc_pending_reply_finish(entry);
+    }
+}
+
+/*
+ * Fails every request that is waiting for a reply on @lane, with the lock
+ * held.
+ */
+static void ipc_fail_pending_locked(i3ipcConnection *self, i3ipcLane *lane, const GError *error,
+                                    GQueue *completed) {
+    i3ipcPendingReply *entry;
+
+    while ((entry = g_queue_pop_head(lane->pending)) != NULL) {
+        ipc_pending_reply_resolve(entry, NULL, g_error_copy(error), completed);
+    }
+
+    g_cond_broadcast(&self->priv->reply_cond);
+}
+
+/*
+ * Returns a cancelled request to its caller right away. The entry stays in
+ * the queue so the reply that is still on its way gets discarded.
+ */
+static gboolean ipc_on_request_cancelled(GCancellable *cancellable, gpointer user_data) {
+    GTask *task = ipc_pending_reply_steal_task(user_data);
+
+    if (task != NULL) {
+        g_task_return_error_if_cancelled(task);
+        g_object_unref(task);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Fills in an event that is ready to be emitted.
+ */
+static void ipc_queued_event_set(i3ipcQueuedEvent *queued, guint signal, GQuark detail,
+                                 gpointer event) {
+    queued->next = NULL;
+    queued->signal = signal;
+    queued->detail = detail;
+    queued->event = event;
+}
+
+static GType ipc_event_type(guint signal) {
+    switch (signal) {
+    case WORKSPACE:
+        return I3IPC_TYPE_WORKSPACE_EVENT;
+    case OUTPUT:
+    case MODE:
+        return I3IPC_TYPE_GENERIC_EVENT;
+    case WINDOW:
+        return I3IPC_TYPE_WINDOW_EVENT;
+    case BARCONFIG_UPDATE:
+        return I3IPC_TYPE_BARCONFIG_UPDATE_EVENT;
+    case BINDING:
+        return I3IPC_TYPE_BINDING_EVENT;
+    default:
+        g_return_val_if_reached(G_TYPE_INVALID);
+    }
+}
+
+/*
+ * The values of a batch hold a reference on a shared event, which the value
+ * itself does not own.
+ */
+static void ipc_batch_value_free(gpointer data) {
+    i3ipc_shared_event_unref(g_value_get_boxed(data));
+    g_value_unset(data);
+    g_free(data);
+}
+
+/*
+ * Starts collecting the events that are delivered from here on for
+ * #i3ipcConnection::events, unless a batch is collected already or nobody is
+ * connected to it. Returns TRUE when ipc_end_batch() has to emit it.
+ */
+static gboolean ipc_begin_batch(i3ipcConnection *self) {
+    if (self->priv->batch != NULL ||
+        !g_signal_has_handler_pending(self, connection_signals[EVENTS], 0, FALSE)) {
+        return FALSE;
+    }
+
+    self->priv->batch = g_ptr_array_new_with_free_func(ipc_batch_value_free);
+
+    return TRUE;
+}
+
+static void ipc_end_batch(i3ipcConnection *self, gboolean began) {
+    GPtrArray *batch = self->priv->batch;
+
+    if (!began) {
+        return;
+    }
+
+    self->priv->batch = NULL;
+
+    if (batch->len > 0) {
+        g_signal_emit(self, connection_signals[EVENTS], 0, batch);
+    }
+
+    g_ptr_array_unref(batch);
+}
+
+/*
+ * Emits a decoded event. The signals pass it with a static scope, so it is not
+ * copied for every handler, and the handlers that keep it make their own copy.
+ */
+static void ipc_deliver_event(i3ipcConnection *self, guint signal, GQuark detail,
+                              gpointer event) {
+    if (self->priv->batch != NULL) {
+        GValue *value = g_new0(GValue, 1);
+
+        g_value_init(value, ipc_event_type(signal));
+        g_value_set_static_boxed(value, i3ipc_shared_event_ref(event));
+        g_ptr_array_add(self->priv->batch, value);
+    }
+
+    g_signal_emit(self, connection_signals[signal], detail, event);
+    i3ipc_shared_event_unref(event);
+}
+
+/*
+ * The events of one type and change that are held back for a while, so that
+ * a burst of them for the same con is delivered as its last event. A policy
+ * without a change applies to all the changes that have no policy of their
+ * own.
+ */
+typedef struct {
+    guint signal;
+    GQuark detail;
+    guint interval;
+    guint64 suppressed;
+    GQueue pending;
+    GSource *timeout;
+} i3ipcCoalescePolicy;
+
+/*
+ * The latest event held back for a con.
+ */
+typedef struct {
+    gulong con_id;
+    GQuark detail;
+    gpointer event;
+} i3ipcCoalescedEvent;
+
+static void ipc_coalesce_policy_free(gpointer data) {
+    i3ipcCoalescePolicy *policy = data;
+    i3ipcCoalescedEvent *held;
+
+    if (policy->timeout != NULL) {
+        g_source_destroy(policy->timeout);
+        g_source_unref(policy->timeout);
+    }
+
+    while ((held = g_queue_pop_head(&policy->pending)) != NULL) {
+        i3ipc_shared_event_unref(held->event);
+        g_slice_free(i3ipcCoalescedEvent, held);
+    }
+
+    g_slice_free(i3ipcCoalescePolicy, policy);
+}
+
+static i3ipcCoalescePolicy *ipc_coalesce_policy_find(i3ipcConnection *self, guint signal,
+                                                     GQuark detail) {
+    for (guint i = 0; i < self->priv->coalesce_policies->len; i += 1) {
+        i3ipcCoalescePolicy *policy = g_ptr_array_index(self->priv->coalesce_policies, i);
+
+        if (policy->signal == signal && policy->detail == detail) {
+            return policy;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * The con an event is about, which is what held back events are matched by.
+ * Events without one are all about the same thing.
+ */
+static gulong ipc_event_con_id(guint signal, gpointer event) {
+    i3ipcCon *con = NULL;
+
+    if (signal == WORKSPACE) {
+        con = ((i3ipcWorkspaceEvent *)event)->current;
+    } else if (signal == WINDOW) {
+        con = ((i3ipcWindowEvent *)event)->container;
+    }
+
+    return (con != NULL ? i3ipc_con_get_id(con) : 0);
+}
+
+/*
+ * Delivers events that a policy held back, in the order they came in.
+ */
+static void ipc_deliver_held_events(i3ipcConnection *self, guint signal, GQueue *pending) {
+    i3ipcCoalescedEvent *held;
+    gboolean batch = ipc_begin_batch(self);
+
+    while ((held = g_queue_pop_head(pending)) != NULL) {
+        ipc_deliver_event(self, signal, held->detail, held->event);
+        g_slice_free(i3ipcCoalescedEvent, held);
+    }
+
+    ipc_end_batch(self, batch);
+}
+
+/*
+ * Delivers the events held back by the policy whose timeout this is. The policy
+ * is looked up under the lock, since it may have been removed meanwhile.
+ */
+static gboolean ipc_on_coalesce_timeout(gpointer user_data) {
+    i3ipcConnection *self = g_object_ref(user_data);
+    GSource *source = g_main_current_source();
+    i3ipcCoalescePolicy *policy = NULL;
+    guint signal = 0;
+    GQueue pending = G_QUEUE_INIT;
+
+    g_mutex_lock(&self->priv->lock);
+
+    for (guint i = 0; i < self->priv->coalesce_policies->len; i += 1) {
+        policy = g_ptr_array_index(self->priv->coalesce_policies, i);
+
+        if (policy->timeout == source) {
+            signal = policy->signal;
+            pending = policy->pending;
+            g_queue_init(&policy->pending);
+            g_clear_pointer(&policy->timeout, g_source_unref);
+            break;
+        }
+    }
+
+    g_mutex_unlock(&self->priv->lock);
+
+    /* a handler may remove the policy, so it is not used from here on */
+    ipc_deliver_held_events(self, signal, &pending);
+    g_object_unref(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * The events a removed policy held back, which are delivered on the events
+ * context.
+ */
+typedef struct {
+    i3ipcConnection *conn;
+    guint signal;
+    GQueue pending;
+} i3ipcCoalesceFlush;
+
+static gboolean ipc_on_coalesce_flush(gpointer user_data) {
+    i3ipcCoalesceFlush *flush = user_data;
+
+    ipc_deliver_held_events(flush->conn, flush->signal, &flush->pending);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void ipc_coalesce_flush_free(gpointer data) {
+    i3ipcCoalesceFlush *flush = data;
+    i3ipcCoalescedEvent *held;
+
+    while ((held = g_queue_pop_head(&flush->pending)) != NULL) {
+        i3ipc_shared_event_unref(held->event);
+        g_slice_free(i3ipcCoalescedEvent, held);
+    }
+
+    g_object_unref(flush->conn);
+    g_slice_free(i3ipcCoalesceFlush, flush);
+}
+
+/*
+ * Holds back an event that a coalescing policy applies to, in place of the
+ * event that is held back for the same con. Returns FALSE when the event is to
+ * be emitted right away.
+ */
+static gboolean ipc_coalesce_event(i3ipcConnection *self, guint signal, GQuark detail,
+                                   gpointer event) {
+    i3ipcCoalescePolicy *policy;
+    i3ipcCoalescedEvent *held = NULL;
+    gulong con_id;
+
+    g_mutex_lock(&self->priv->lock);
+
+    if (self->priv->coalesce_policies->len == 0 ||
+        ((policy = ipc_coalesce_policy_find(self, signal, detail)) == NULL &&
+         (policy = ipc_coalesce_policy_find(self, signal, 0)) == NULL)) {
+        g_mutex_unlock(&self->priv->lock);
+        return FALSE;
+    }
+
+    con_id = ipc_event_con_id(signal, event);
+
+    for (GList *l = policy->pending.head; l != NULL; l = l->next) {
+        if (((i3ipcCoalescedEvent *)l->data)->con_id == con_id) {
+            held = l->data;
+
+            /* the replacing event goes where it happened, after the others */
+            g_queue_unlink(&policy->pending, l);
+            g_queue_push_tail_link(&policy->pending, l);
+            break;
+        }
+    }
+
+    if (held != NULL) {
+        i3ipc_shared_event_unref(held->event);
+        policy->suppressed += 1;
+    } else {
+        held = g_slice_new(i3ipcCoalescedEvent);
+        held->con_id = con_id;
+        g_queue_push_tail(&policy->pending, held);
+    }
+
+    held->detail = detail;
+    held->event = event;
+
+    if (policy->timeout == NULL) {
+        policy->timeout = g_timeout_source_new(policy->interval);
+        g_source_set_callback(policy->timeout, ipc_on_coalesce_timeout, self, NULL);
+        g_source_set_name(policy->timeout, "i3ipc coalesce events");
+        g_source_attach(policy->timeout, self->priv->events_context);
+    }
+
+    g_mutex_unlock(&self->priv->lock);
+
+    return TRUE;
+}
+
+/*
+ * Emits a decoded event, unless a coalescing policy holds it back.
+ */
+static void ipc_emit_event(i3ipcConnection *self, guint signal, GQuark detail, gpointer event) {
+    if (!ipc_coalesce_event(self, signal, detail, event)) {
+        ipc_deliver_event(self, signal, detail, event);
+    }
+}
+
+/*
+ * Frees an event that was decoded but never emitted.
+ */
+static void ipc_queued_event_free(gpointer data) {
+    i3ipcQueuedEvent *queued = data;
+
+    i3ipc_shared_event_unref(queued->event);
+    g_slice_free(i3ipcQueuedEvent, queued);
+}
+
+/*
+ * Pushes an event on the stack of the events that the event thread decoded.
+ * The stack is all the event thread shares with the events context, so it
+ * does not take a lock: the event goes on top with a compare-and-swap, and
+ * the events context takes the whole stack at once. Returns TRUE when the
+ * stack was empty, which means the events context has to be woken up.
+ */
+static gboolean ipc_event_stack_push(i3ipcConnection *self, i3ipcQueuedEvent *queued) {
+    i3ipcQueuedEvent *head;
+
+    do {
+        head = g_atomic_pointer_get(&self->priv->event_stack);
+        queued->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&self->priv->event_stack, head, queued));
+
+    return (head == NULL);
+}
+
+/*
+ * Takes all the events off the stack and appends them to the backlog in the
+ * order they were received.
+ */
+static void ipc_event_stack_take(i3ipcConnection *self) {
+    i3ipcQueuedEvent *head;
+    i3ipcQueuedEvent *reversed = NULL;
+
+    do {
+        head = g_atomic_pointer_get(&self->priv->event_stack);
+    } while (head != NULL &&
+             !g_atomic_pointer_compare_and_exchange(&self->priv->event_stack, head, NULL));
+
+    while (head != NULL) {
+        i3ipcQueuedEvent *next = head->next;
+
+        head->next = reversed;
+        reversed = head;
+        head = next;
+    }
+
+    for (; reversed != NULL; reversed = reversed->next) {
+        g_queue_push_tail(&self->priv->event_backlog, reversed);
+    }
+}
+
+static gboolean ipc_has_queued_events(i3ipcConnection *self) {
+    return (!g_queue_is_empty(&self->priv->event_backlog) ||
+            g_atomic_pointer_get(&self->priv->event_stack) != NULL);
+}
+
+/*
+ * The subscriptions are read and written under the lock, since they change
+ * from whichever thread subscribes, narrows or reconnects.
+ */
+static i3ipcEvent ipc_get_subscriptions(i3ipcConnection *self) {
+    i3ipcEvent subscriptions;
+
+    g_mutex_lock(&self->priv->lock);
+    subscriptions = self->priv->subscriptions;
+    g_mutex_unlock(&self->priv->lock);
+
+    return subscriptions;
+}
+
+static void ipc_set_subscriptions(i3ipcConnection *self, i3ipcEvent subscriptions) {
+    g_mutex_lock(&self->priv->lock);
+    self->priv->subscriptions = subscriptions;
+    g_mutex_unlock(&self->priv->lock);
+}
+
+static void i3ipc_connection_set_property(GObject *object, guint property_id, const GValue *value,
+                                          GParamSpec *pspec) {
+    i3ipcConnection *self = I3IPC_CONNECTION(object);
+
+    switch (property_id) {
+    case PROP_SOCKET_PATH:
+        g_free(self->priv->socket_path);
+        self->priv->socket_path = g_value_dup_string(value);
+        break;
+
+    case PROP_TRANSPORT:
+        g_clear_object(&self->priv->transport);
+        self->priv->transport = g_value_dup_object(value);
+        break;
+
+    case PROP_AUTO_RECONNECT:
+        self->priv->auto_reconnect = g_value_get_boolean(value);
+        break;
+
+    case PROP_TIMEOUT:
+        self->priv->timeout = g_value_get_int(value);
+        break;
+
+    case PROP_EVENT_PRIORITY:
+        self->priv->event_priority = g_value_get_int(value);
+
+        if (self->priv->sub_source != NULL) {
+            g_source_set_priority(self->priv->sub_source, self->priv->event_priority);
+        }
+        break;
+
+    case PROP_EVENT_THREAD:
+        self->priv->event_thread = g_value_get_boolean(value);
+
+        if (self->priv->sub_source != NULL) {
+            /* starts or stops the thread */
+            ipc_attach_events(self, self->priv->events_context);
+        }
+        break;
+
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void i3ipc_connection_get_property(GObject *object, guint property_id, GValue *value,
+                                          GParamSpec *pspec) {
+    i3ipcConnection *self = I3IPC_CONNECTION(object);
+
+    switch (property_id) {
+    case PROP_SUBSCRIPTIONS:
+        g_value_set_flags(value, ipc_get_subscriptions(self));
+        break;
+
+    case PROP_SOCKET_PATH:
+        g_value_set_string(value, self->priv->socket_path);
+        break;
+
+    case PROP_CONNECTED:
+        g_value_set_boolean(value, self->priv->connected);
+        break;
+
+    case PROP_EVENT_PRIORITY:
+        g_value_set_int(value, self->priv->event_priority);
+        break;
+
+    case PROP_AUTO_RECONNECT:
+        g_value_set_boolean(value, self->priv->auto_reconnect);
+        break;
+
+    case PROP_TIMEOUT:
+        g_value_set_int(value, self->priv->timeout);
+        break;
+
+    case PROP_EVENT_THREAD:
+        g_value_set_boolean(value, self->priv->event_thread);
+        break;
+
+    case PROP_TRANSPORT:
+        g_value_set_object(value, self->priv->transport);
+        break;
+
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void i3ipc_connection_dispose(GObject *gobject) {
+    i3ipcConnection *self = I3IPC_CONNECTION(gobject);
+
+    g_clear_error(&self->priv->init_error);
+
+    ipc_event_reader_stop(self);
+
+    if (self->priv->cmd_lane.source != NULL) {
+        g_source_destroy(self->priv->cmd_lane.source);
+        g_clear_pointer(&self->priv->cmd_lane.source, g_source_unref);
+    }
+
+    if (self->priv->sub_source != NULL) {
+        g_source_destroy(self->priv->sub_source);
+        g_clear_pointer(&self->priv->sub_source, g_source_unref);
+    }
+
+    if (self->priv->reconnect_source != NULL) {
+        g_source_destroy(self->priv->reconnect_source);
+        g_clear_pointer(&self->priv->reconnect_source, g_source_unref);
+    }
+
+    g_mutex_lock(&self->priv->lock);
+
+    if (self->priv->narrow_source != NULL) {
+        g_source_destroy(self->priv->narrow_source);
+        g_clear_pointer(&self->priv->narrow_source, g_source_unref);
+    }
+
+    /* the events that are held back are dropped */
+    g_ptr_array_set_size(self->priv->coalesce_policies, 0);
+
+    g_mutex_unlock(&self->priv->lock);
+
+    if (self->priv->cmd_lane.channel != NULL) {
+        g_io_channel_shutdown(self->priv->cmd_lane.channel, TRUE, NULL);
+        g_clear_pointer(&self->priv->cmd_lane.channel, g_io_channel_unref);
+    }
+
+    if (self->priv->high_lane.channel != NULL) {
+        g_io_channel_shutdown(self->priv->high_lane.channel, TRUE, NULL);
+        g_clear_pointer(&self->priv->high_lane.channel, g_io_channel_unref);
+    }
+
+    if (self->priv->sub_channel != NULL) {
+        g_io_channel_shutdown(self->priv->sub_channel, TRUE, NULL);
+        self->priv->sub_channel = (g_io_channel_unref(self->priv->sub_channel), NULL);
+    }
+
+    /* handlers disconnected from here on do not narrow the subscriptions */
+    g_mutex_lock(&self->priv->lock);
+    g_clear_pointer(&self->priv->events_context, g_main_context_unref);
+    g_mutex_unlock(&self->priv->lock);
+
+    g_clear_object(&self->priv->transport);
+
+    G_OBJECT_CLASS(i3ipc_connection_parent_class)->dispose(gobject);
+}
+
+static void i3ipc_connection_finalize(GObject *gobject) {
+    i3ipcConnection *self = I3IPC_CONNECTION(gobject);
+
+#ifdef I3IPC_HAVE_IO_URING
+    i3ipc_uring_free(self->priv->uring);
+    g_mutex_clear(&self->priv->uring_lock);
+#endif
+
+    g_free(self->priv->socket_path);
+    ipc_lane_clear(&self->priv->cmd_lane);
+    ipc_lane_clear(&self->priv->high_lane);
+    ipc_framer_clear(&self->priv->sub_framer);
+    ipc_event_stack_take(self);
+    g_list_free_full(self->priv->event_backlog.head, ipc_queued_event_free);
+    g_list_free_full(self->priv->sub_replies.head, g_free);
+    g_ptr_array_unref(self->priv->coalesce_policies);
+    g_object_unref(self->priv->reply_parser);
+    g_object_unref(self->priv->event_parser);
+    g_mutex_clear(&self->priv->lock);
+    g_mutex_clear(&self->priv->parser_lock);
+    g_cond_clear(&self->priv->reply_cond);
+    g_rec_mutex_clear(&self->priv->reconnect_lock);
+
+    G_OBJECT_CLASS(i3ipc_connection_parent_class)->finalize(gobject);
+}
+
+static void i3ipc_connection_class_init(i3ipcConnectionClass *klass) {
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->set_property = i3ipc_connection_set_property;
+    gobject_class->get_property = i3ipc_connection_get_property;
+    gobject_class->dispose = i3ipc_connection_dispose;
+    gobject_class->finalize = i3ipc_connection_finalize;
+
+    obj_properties[PROP_SUBSCRIPTIONS] =
+        g_param_spec_flags("subscriptions", "Connection subscriptions",
+                           "The subscriptions this connection is subscribed to", I3IPC_TYPE_EVENT,
+                           0, G_PARAM_READABLE);
+
+    obj_properties[PROP_SOCKET_PATH] = g_param_spec_string(
+        "socket-path", "Connection socket path",
+        "The path of the unix socket the connection is connected to", NULL, /* default */
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    obj_properties[PROP_CONNECTED] = g_param_spec_boolean(
+        "connected", "Connection connected",
+        "Whether or not a connection has been established to the ipc", FALSE, G_PARAM_READABLE);
+
+    obj_properties[PROP_EVENT_PRIORITY] = g_param_spec_int(
+        "event-priority", "Connection event priority",
+        "The priority of the source that emits the events in the main context", G_MININT,
+        G_MAXINT, G_PRIORITY_DEFAULT, G_PARAM_READWRITE);
+
+    obj_properties[PROP_TRANSPORT] = g_param_spec_object(
+        "transport", "Connection transport",
+        "The transport that opens the sockets to the ipc, or NULL to connect to the unix socket "
+        "of i3",
+        I3IPC_TYPE_TRANSPORT, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    obj_properties[PROP_AUTO_RECONNECT] = g_param_spec_boolean(
+        "auto-reconnect", "Connection auto reconnect",
+        "Whether to connect again and restore the subscriptions when the ipc goes away", FALSE,
+        G_PARAM_READWRITE);
+
+    obj_properties[PROP_TIMEOUT] = g_param_spec_int(
+        "timeout", "Connection timeout",
+        "How long synchronous requests wait for their reply in milliseconds, or -1 to wait "
+        "forever",
+        -1, G_MAXINT, -1, G_PARAM_READWRITE);
+
+    obj_properties[PROP_EVENT_THREAD] = g_param_spec_boolean(
+        "event-thread", "Connection event thread",
+        "Whether the events are read and decoded in a thread of their own, so that only the "
+        "signals are emitted from the main context",
+        FALSE, G_PARAM_READWRITE);
+
+    g_object_class_install_properties(gobject_class, N_PROPERTIES, obj_properties);
+
+    /**
+     * i3ipcConnection::workspace:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     * @e: The workspace event object
+     *
+     * Sent when the user switches to a different workspace, when a new workspace
+     * is initialized or when a workspace is removed (because the last client
+     * vanished).
+     */
+    connection_signals[WORKSPACE] =
+        g_signal_new("workspace",                           /* signal_name */
+                     I3IPC_TYPE_CONNECTION,                 /* itype */
+                     G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED, /* signal_flags */
+                     0,                                     /* class_offset */
+                     NULL,                                  /* accumulator */
+                     NULL,                                  /* accu_data */
+                     g_cclosure_marshal_VOID__BOXED,        /* c_marshaller */
+                     G_TYPE_NONE,                           /* return_type */
+                     1,                                     /* n_params */
+                     I3IPC_TYPE_WORKSPACE_EVENT | G_SIGNAL_TYPE_STATIC_SCOPE);
+
+    /**
+     * i3ipcConnection::output:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     * @e: The output event object
+     *
+     * Sent when RandR issues a change notification (of either screens, outputs,
+     * CRTCs or output properties).
+     */
+    connection_signals[OUTPUT] =
+        g_signal_new("output",                               /* signal_name */
+                     I3IPC_TYPE_CONNECTION,                  /* itype */
+                     G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
+                     0,                                      /* class_offset */
+                     NULL,                                   /* accumulator */
+                     NULL,                                   /* accu_data */
+                     g_cclosure_marshal_VOID__BOXED,         /* c_marshaller */
+                     G_TYPE_NONE,                            /* return_type */
+                     1,                                      /* n_params */
+                     I3IPC_TYPE_GENERIC_EVENT | G_SIGNAL_TYPE_STATIC_SCOPE);
+
+    /**
+     * i3ipcConnection::mode:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     * @e: The mode event object
+     *
+     * Sent whenever i3 changes its binding mode.
+     */
+    connection_signals[MODE] =
+        g_signal_new("mode",                                 /* signal_name */
+                     I3IPC_TYPE_CONNECTION,                  /* itype */
+                     G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
+                     0,                                      /* class_offset */
+                     NULL,                                   /* accumulator */
+                     NULL,                                   /* accu_data */
+                     g_cclosure_marshal_VOID__BOXED,         /* c_marshaller */
+                     G_TYPE_NONE,                            /* return_type */
+                     1,                                      /* n_params */
+                     I3IPC_TYPE_GENERIC_EVENT | G_SIGNAL_TYPE_STATIC_SCOPE);
+
+    /**
+     * i3ipcConnection::window:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     * @e: The window event object
+     *
+     * Sent when a client’s window is successfully reparented (that is when i3
+     * has finished fitting it into a container).
+     */
+    connection_signals[WINDOW] =
+        g_signal_new("window",                               /* signal_name */
+                     I3IPC_TYPE_CONNECTION,                  /* itype */
+                     G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
+                     0,                                      /* class_offset */
+                     NULL,                                   /* accumulator */
+                     NULL,                                   /* accu_data */
+                     g_cclosure_marshal_VOID__BOXED,         /* c_marshaller */
+                     G_TYPE_NONE,                            /* return_type */
+                     1,                                      /* n_params */
+                     I3IPC_TYPE_WINDOW_EVENT | G_SIGNAL_TYPE_STATIC_SCOPE);
+
+    /**
+     * i3ipcConnection::barconfig_update:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     * @e: The barconfig_update event object
+     *
+     * Sent when the hidden_state or mode field in the barconfig of any bar
+     * instance was updated.
+     */
+    connection_signals[BARCONFIG_UPDATE] =
+        g_signal_new("barconfig_update",                    /* signal_name */
+                     I3IPC_TYPE_CONNECTION,                 /* itype */
+                     G_SIGNAL_RUN_FIRST,                    /* signal_flags */
+                     0,                                     /* class_offset */
+                     NULL,                                  /* accumulator */
+                     NULL,                                  /* accu_data */
+                     g_cclosure_marshal_VOID__BOXED,        /* c_marshaller */
+                     G_TYPE_NONE,                           /* return_type */
+                     1,                                     /* n_params */
+                     I3IPC_TYPE_BARCONFIG_UPDATE_EVENT | G_SIGNAL_TYPE_STATIC_SCOPE);
+
+    /**
+     * i3ipcConnection::binding:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     * @e: the binding event object
+     *
+     * Sent when a binding was triggered with the keyboard or mouse because of
+     * some user input.
+     */
+    connection_signals[BINDING] =
+        g_signal_new("binding",                              /* signal_name */
+                     I3IPC_TYPE_CONNECTION,                  /* itype */
+                     G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, /* signal_flags */
+                     0,                                      /* class_offset */
+                     NULL,                                   /* accumulator */
+                     NULL,                                   /* accu_data */
+                     g_cclosure_marshal_VOID__BOXED,         /* c_marshaller */
+                     G_TYPE_NONE,                            /* return_type */
+                     1,                                      /* n_params */
+                     I3IPC_TYPE_BINDING_EVENT | G_SIGNAL_TYPE_STATIC_SCOPE);
+
+    /**
+     * i3ipcConnection::ipc_shutdown:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     *
+     * Sent when the Connection receives notice that the ipc has shut down.
+     */
+    connection_signals[IPC_SHUTDOWN] =
+        g_signal_new("ipc_shutdown",                /* signal_name */
+                     I3IPC_TYPE_CONNECTION,         /* itype */
+                     G_SIGNAL_RUN_FIRST,            /* signal_flags */
+                     0,                             /* class_offset */
+                     NULL,                          /* accumulator */
+                     NULL,                          /* accu_data */
+                     g_cclosure_marshal_VOID__VOID, /* c_marshaller */
+                     G_TYPE_NONE,                   /* return_type */
+                     0);                            /* n_params */
+
+    /**
+     * i3ipcConnection::reconnected:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     * @gap: how long the connection was down, in microseconds
+     *
+     * Sent when #i3ipcConnection:auto-reconnect is set and the connection was
+     * established again after the ipc went away, such as when i3 restarted.
+     * The subscriptions are restored by then, but events that happened during
+     * the gap are lost, so any state that depends on them should be fetched
+     * again.
+     */
+    connection_signals[RECONNECTED] =
+        g_signal_new("reconnected",                /* signal_name */
+                     I3IPC_TYPE_CONNECTION,        /* itype */
+                     G_SIGNAL_RUN_FIRST,           /* signal_flags */
+                     0,                            /* class_offset */
+                     NULL,                         /* accumulator */
+                     NULL,                         /* accu_data */
+                     g_cclosure_marshal_generic,   /* c_marshaller */
+                     G_TYPE_NONE,                  /* return_type */
+                     1, G_TYPE_INT64);             /* n_params */
+
+    /**
+     * i3ipcConnection::events:
+     * @self: the #i3ipcConnection on which the signal was emitted
+     * @events: (element-type GValue): the event objects, in the order they
+     * were delivered
+     *
+     * Sent once per dispatch of the events with all of the events that were
+     * delivered in it, after their own signals were emitted. Connecting to it
+     * lets a handler run once per wakeup during a storm of events instead of
+     * once per event. The events still have to be subscribed to, and while a
+     * handler is connected they are all decoded, whether or not their own
+     * signals have handlers.
+     */
+    connection_signals[EVENTS] =
+        g_signal_new("events",                       /* signal_name */
+                     I3IPC_TYPE_CONNECTION,          /* itype */
+                     G_SIGNAL_RUN_FIRST,             /* signal_flags */
+                     0,                              /* class_offset */
+                     NULL,                           /* accumulator */
+                     NULL,                           /* accu_data */
+                     g_cclosure_marshal_VOID__BOXED, /* c_marshaller */
+                     G_TYPE_NONE,                    /* return_type */
+                     1,                              /* n_params */
+                     G_TYPE_PTR_ARRAY | G_SIGNAL_TYPE_STATIC_SCOPE);
+}
+
+static void i3ipc_connection_init(i3ipcConnection *self) {
+    self->priv = i3ipc_connection_get_instance_private(self);
+    ipc_lane_init(&self->priv->cmd_lane);
+    ipc_lane_init(&self->priv->high_lane);
+    g_mutex_init(&self->priv->lock);
+    g_mutex_init(&self->priv->parser_lock);
+    g_cond_init(&self->priv->reply_cond);
+    g_rec_mutex_init(&self->priv->reconnect_lock);
+#ifdef I3IPC_HAVE_IO_URING
+    g_mutex_init(&self->priv->uring_lock);
+#endif
+    ipc_framer_init(&self->priv->sub_framer);
+    g_queue_init(&self->priv->event_backlog);
+    g_queue_init(&self->priv->sub_replies);
+    self->priv->coalesce_policies = g_ptr_array_new_with_free_func(ipc_coalesce_policy_free);
+    self->priv->reply_parser = json_parser_new();
+    self->priv->event_parser = json_parser_new();
+    self->priv->event_priority = G_PRIORITY_DEFAULT;
+    self->priv->timeout = -1;
+}
+
+/**
+ * i3ipc_connection_new:
+ * @socket_path: (allow-none): the path of the socket to connect to
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Allocates a new #i3ipcConnection
+ *
+ * When @socket_path is NULL, the socket is found from the I3SOCK or SWAYSOCK
+ * environment variables, the path found by an earlier connection of the user,
+ * the sockets in $XDG_RUNTIME_DIR/i3, and finally the root window of the X
+ * server, in that order.
+ *
+ * Returns: (transfer full): a new #i3ipcConnection
+ */
+i3ipcConnection *i3ipc_connection_new(const gchar *socket_path, GError **err) {
+    i3ipcConnection *conn;
+    GError *tmp_error = NULL;
+
+    conn = g_initable_new(I3IPC_TYPE_CONNECTION, NULL, &tmp_error, "socket-path", socket_path,
+                          NULL);
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return NULL;
+    }
+
+    return conn;
+}
+
+/**
+ * i3ipc_connection_new_with_transport:
+ * @transport: the transport that opens the sockets to the ipc
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Allocates a new #i3ipcConnection that talks to the ipc over @transport.
  *
  * Returns: (transfer full): a new #i3ipcConnection
  */
-i3ipcConnection *i3ipc_connection_new(const gchar *socket_path, GError **err) {
-    i3ipcConnection *conn;
+i3ipcConnection *i3ipc_connection_new_with_transport(i3ipcTransport *transport, GError **err) {
+    i3ipcConnection *conn;
+    GError *tmp_error = NULL;
+
+    g_return_val_if_fail(I3IPC_IS_TRANSPORT(transport), NULL);
+
+    conn = g_initable_new(I3IPC_TYPE_CONNECTION, NULL, &tmp_error, "transport", transport, NULL);
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return NULL;
+    }
+
+    return conn;
+}
+
+/**
+ * i3ipc_connection_new_async:
+ * @socket_path: (allow-none): the path of the socket to connect to
+ * @cancellable: (allow-none): a #GCancellable or NULL
+ * @callback: (scope async): the callback to call when the connection is ready
+ * @user_data: (closure): the data to pass to @callback
+ *
+ * Starts creating a new #i3ipcConnection without blocking. The socket is
+ * looked up and connected to in a thread, and @callback is invoked from the
+ * thread-default #GMainContext of the caller, where the events of the
+ * connection are emitted as well. Call i3ipc_connection_new_finish() from
+ * @callback to get the connection.
+ */
+void i3ipc_connection_new_async(const gchar *socket_path, GCancellable *cancellable,
+                                GAsyncReadyCallback callback, gpointer user_data) {
+    g_async_initable_new_async(I3IPC_TYPE_CONNECTION, G_PRIORITY_DEFAULT, cancellable, callback,
+                               user_data, "socket-path", socket_path, NULL);
+}
+
+/**
+ * i3ipc_connection_new_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_new_async().
+ *
+ * Returns: (transfer full): a new #i3ipcConnection, or NULL on error
+ */
+i3ipcConnection *i3ipc_connection_new_finish(GAsyncResult *result, GError **err) {
+    GObject *source;
+    GObject *conn;
+
+    source = g_async_result_get_source_object(result);
+    conn = g_async_initable_new_finish(G_ASYNC_INITABLE(source), result, err);
+    g_object_unref(source);
+
+    return (conn != NULL ? I3IPC_CONNECTION(conn) : NULL);
+}
+
+/**
+ * i3ipc_connection_new_wait:
+ * @socket_path: (allow-none): the path of the socket to connect to
+ * @timeout: how long to wait in milliseconds, or -1 to wait for as long as it
+ * takes
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Like i3ipc_connection_new(), but waits for the ipc to come up when it is not
+ * there yet, such as while the window manager is starting. Instead of retrying
+ * in a loop, it sleeps until the directory of the socket changes, using
+ * inotify where it is available.
+ *
+ * Only a socket that is not there yet, a socket that refuses connections and
+ * a window manager that has not published its socket yet are waited out. Any
+ * other error is returned right away.
+ *
+ * Returns: (transfer full): a new #i3ipcConnection, or NULL when the ipc did not
+ * come up in time
+ */
+i3ipcConnection *i3ipc_connection_new_wait(const gchar *socket_path, gint timeout, GError **err) {
+    i3ipcConnection *conn;
+    i3ipcSocketWatch *watch;
+    GError *tmp_error = NULL;
+    gint64 deadline = (timeout < 0 ? -1 : g_get_monotonic_time() + (gint64)timeout * 1000);
+
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+
+    /* watch first, so a socket created during an attempt is not missed */
+    watch = i3ipc_socket_watch_new(socket_path);
+
+    while ((conn = i3ipc_connection_new(socket_path, &tmp_error)) == NULL) {
+        /* errors that go away once the window manager is up, which includes
+         * discovery not finding a socket yet */
+        gboolean not_ready =
+            (g_error_matches(tmp_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) ||
+             g_error_matches(tmp_error, G_IO_ERROR, G_IO_ERROR_CONNECTION_REFUSED));
+
+        if (!not_ready || !i3ipc_socket_watch_wait(watch, deadline)) {
+            g_propagate_error(err, tmp_error);
+            break;
+        }
+
+        g_clear_error(&tmp_error);
+    }
+
+    i3ipc_socket_watch_free(watch);
+
+    return conn;
+}
+
+static gchar *i3ipc_connection_get_socket_path(i3ipcConnection *self, GError **err) {
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+
+    if (self->priv->socket_path != NULL) {
+        return self->priv->socket_path;
+    }
+
+    return i3ipc_discover_socket_path(err);
+}
+
+/*
+ * The fd to wait on for events. With io_uring the events are received by the
+ * ring, so that is the fd that becomes readable.
+ */
+static int ipc_event_fd(i3ipcConnection *self) {
+#ifdef I3IPC_HAVE_IO_URING
+    if (self->priv->uring != NULL) {
+        return i3ipc_uring_get_fd(self->priv->uring);
+    }
+#endif
+
+    return g_io_channel_unix_get_fd(self->priv->sub_channel);
+}
+
+/*
+ * The subscription socket and its framer belong to one reader at a time: the
+ * event thread while it runs, or else whoever dispatches the events or waits
+ * for the reply to a subscription. Waits until the role is free when another
+ * thread has it.
+ */
+static void ipc_sub_reader_take(i3ipcConnection *self) {
+    g_mutex_lock(&self->priv->lock);
+
+    while (self->priv->sub_reading) {
+        g_cond_wait(&self->priv->reply_cond, &self->priv->lock);
+    }
+
+    self->priv->sub_reading = TRUE;
+    g_mutex_unlock(&self->priv->lock);
+}
+
+static void ipc_sub_reader_release(i3ipcConnection *self) {
+    g_mutex_lock(&self->priv->lock);
+    self->priv->sub_reading = FALSE;
+    g_cond_broadcast(&self->priv->reply_cond);
+    g_mutex_unlock(&self->priv->lock);
+}
+
+/*
+ * Whether complete messages are buffered for the subscription socket. Only
+ * looks when nobody is reading, since the reader owns the framer.
+ */
+static gboolean ipc_sub_framer_has_message(i3ipcConnection *self) {
+    gboolean retval = FALSE;
+
+    g_mutex_lock(&self->priv->lock);
+
+    if (!self->priv->sub_reading) {
+        retval = ipc_framer_has_message(&self->priv->sub_framer);
+    }
+
+    g_mutex_unlock(&self->priv->lock);
+
+    return retval;
+}
+
+/*
+ * Reads the events that are available into the framer of the subscription
+ * channel without blocking. Called with the reader role held.
+ */
+static GIOStatus ipc_fill_events(i3ipcConnection *self, GError **err) {
+#ifdef I3IPC_HAVE_IO_URING
+    if (self->priv->uring != NULL) {
+        GIOStatus status;
+
+        g_mutex_lock(&self->priv->uring_lock);
+        ipc_framer_compact(&self->priv->sub_framer);
+        status = i3ipc_uring_fill_events(self->priv->uring, err);
+        g_mutex_unlock(&self->priv->uring_lock);
+
+        return status;
+    }
+#endif
+
+    return ipc_framer_fill(&self->priv->sub_framer,
+                           g_io_channel_unix_get_fd(self->priv->sub_channel), err);
+}
+
+/*
+ * Finds the string value of the top level "change" member of an event without
+ * parsing it. i3 puts it first, so the scan usually ends after a few bytes.
+ * Returns FALSE when there is none or it has escapes.
+ */
+static gboolean ipc_peek_change(const gchar *payload, uint32_t length, const gchar **change,
+                                gsize *change_length) {
+    static const gchar key[] = "\"change\"";
+    gint depth = 0;
+
+    for (uint32_t i = 0; i < length; i += 1) {
+        switch (payload[i]) {
+        case '{':
+        case '[':
+            depth += 1;
+            break;
+
+        case '}':
+        case ']':
+            depth -= 1;
+            break;
+
+        case '"': {
+            uint32_t start = i;
+            gboolean is_key =
+                (depth == 1 && length - i >= sizeof(key) - 1 &&
+                 memcmp(payload + i, key, sizeof(key) - 1) == 0);
+
+            /* skip to the end of the string */
+            for (i += 1; i < length && payload[i] != '"'; i += 1) {
+                if (payload[i] == '\\') {
+                    i += 1;
+                }
+            }
+
+            if (!is_key || i != start + sizeof(key) - 2) {
+                break;
+            }
+
+            for (i += 1; i < length && g_ascii_isspace(payload[i]); i += 1)
+                ;
+
+            if (i == length || payload[i] != ':') {
+                break;
+            }
+
+            for (i += 1; i < length && g_ascii_isspace(payload[i]); i += 1)
+                ;
+
+            if (i == length || payload[i] != '"') {
+                return FALSE;
+            }
+
+            *change = payload + i + 1;
+
+            for (*change_length = 0; i + 1 + *change_length < length; *change_length += 1) {
+                gchar c = (*change)[*change_length];
+
+                if (c == '"') {
+                    return TRUE;
+                } else if (c == '\\') {
+                    return FALSE;
+                }
+            }
+
+            return FALSE;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Whether any handler would receive an event, judging by its type and change
+ * before it is parsed. Events that cannot be judged are assumed to be wanted.
+ */
+static gboolean ipc_event_is_wanted(i3ipcConnection *self, uint32_t reply_type,
+                                    const gchar *payload, uint32_t reply_length) {
+    const gchar *change;
+    gsize change_length;
+    gchar detail[64];
+    guint signal;
+
+    if (g_signal_has_handler_pending(self, connection_signals[EVENTS], 0, FALSE)) {
+        return TRUE;
+    }
+
+    switch (1 << (reply_type & 0x7F)) {
+    case I3IPC_EVENT_WORKSPACE:
+        signal = WORKSPACE;
+        break;
+    case I3IPC_EVENT_OUTPUT:
+        signal = OUTPUT;
+        break;
+    case I3IPC_EVENT_MODE:
+        signal = MODE;
+        break;
+    case I3IPC_EVENT_WINDOW:
+        signal = WINDOW;
+        break;
+    case I3IPC_EVENT_BARCONFIG_UPDATE:
+        return g_signal_has_handler_pending(self, connection_signals[BARCONFIG_UPDATE], 0, FALSE);
+    case I3IPC_EVENT_BINDING:
+        signal = BINDING;
+        break;
+    default:
+        return TRUE;
+    }
+
+    if (!ipc_peek_change(payload, reply_length, &change, &change_length) ||
+        change_length >= sizeof(detail)) {
+        return TRUE;
+    }
+
+    memcpy(detail, change, change_length);
+    detail[change_length] = '\0';
+
+    /* a change nobody connected to has no quark, which leaves the handlers
+     * that were connected without a detail */
+    return g_signal_has_handler_pending(self, connection_signals[signal],
+                                        g_quark_try_string(detail), FALSE);
+}
+
+/*
+ * Parses an event straight from the receive buffer into @queued. Returns FALSE
+ * when there is nothing to emit.
+ */
+static gboolean ipc_decode_event(i3ipcConnection *self, uint32_t reply_type, const gchar *payload,
+                                 uint32_t reply_length, i3ipcQueuedEvent *queued) {
+    GError *err = NULL;
+    JsonParser *parser = self->priv->event_parser;
+    JsonObject *json_reply;
+    GQuark detail;
+
+    if (!ipc_event_is_wanted(self, reply_type, payload, reply_length)) {
+        return FALSE;
+    }
+
+    json_parser_load_from_data(parser, payload, reply_length, &err);
+
+    if (err) {
+        g_warning("could not parse event reply json (%s)\n", err->message);
+        g_error_free(err);
+        return FALSE;
+    }
+
+    json_reply = json_node_get_object(json_parser_get_root(parser));
+
+    switch (1 << (reply_type & 0x7F)) {
+    case I3IPC_EVENT_WORKSPACE: {
+        i3ipcWorkspaceEvent *e = i3ipc_shared_event_new(I3IPC_TYPE_WORKSPACE_EVENT);
+
+        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+        detail = g_quark_from_string(e->change);
+
+        if (json_object_has_member(json_reply, "current") &&
+            !json_object_get_null_member(json_reply, "current")) {
+            e->current =
+                i3ipc_con_new(NULL, json_object_get_object_member(json_reply, "current"), self);
+        }
+
+        if (json_object_has_member(json_reply, "old") &&
+            !json_object_get_null_member(json_reply, "old")) {
+            e->old = i3ipc_con_new(NULL, json_object_get_object_member(json_reply, "old"), self);
+        }
+
+        ipc_queued_event_set(queued, WORKSPACE, detail, e);
+        break;
+    }
+
+    case I3IPC_EVENT_OUTPUT: {
+        i3ipcGenericEvent *e = i3ipc_shared_event_new(I3IPC_TYPE_GENERIC_EVENT);
+
+        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+        detail = g_quark_from_string(e->change);
+
+        ipc_queued_event_set(queued, OUTPUT, detail, e);
+        break;
+    }
+
+    case I3IPC_EVENT_MODE: {
+        i3ipcGenericEvent *e = i3ipc_shared_event_new(I3IPC_TYPE_GENERIC_EVENT);
+
+        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+        detail = g_quark_from_string(e->change);
+
+        ipc_queued_event_set(queued, MODE, detail, e);
+        break;
+    }
+
+    case I3IPC_EVENT_WINDOW: {
+        i3ipcWindowEvent *e = i3ipc_shared_event_new(I3IPC_TYPE_WINDOW_EVENT);
+
+        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+        detail = g_quark_from_string(e->change);
+
+        if (json_object_has_member(json_reply, "container") &&
+            !json_object_get_null_member(json_reply, "container"))
+            e->container =
+                i3ipc_con_new(NULL, json_object_get_object_member(json_reply, "container"), self);
+
+        ipc_queued_event_set(queued, WINDOW, detail, e);
+        break;
+    }
+
+    case I3IPC_EVENT_BARCONFIG_UPDATE: {
+        i3ipcBarconfigUpdateEvent *e = i3ipc_shared_event_new(I3IPC_TYPE_BARCONFIG_UPDATE_EVENT);
+
+        e->id = g_strdup(json_object_get_string_member(json_reply, "id"));
+        e->hidden_state = g_strdup(json_object_get_string_member(json_reply, "hidden_state"));
+        e->mode = g_strdup(json_object_get_string_member(json_reply, "mode"));
+
+        ipc_queued_event_set(queued, BARCONFIG_UPDATE, 0, e);
+        break;
+    }
+    case I3IPC_EVENT_BINDING: {
+        i3ipcBindingEvent *e = i3ipc_shared_event_new(I3IPC_TYPE_BINDING_EVENT);
+
+        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+        detail = g_quark_from_string(e->change);
+
+        JsonObject *json_binding_info = json_object_get_object_member(json_reply, "binding");
+        e->binding = g_slice_new0(i3ipcBindingInfo);
+        e->binding->command = g_strdup(json_object_get_string_member(json_binding_info, "command"));
+        e->binding->input_code = json_object_get_int_member(json_binding_info, "input_code");
+        e->binding->input_type =
+            g_strdup(json_object_get_string_member(json_binding_info, "input_type"));
+        e->binding->symbol = g_strdup(json_object_get_string_member(json_binding_info, "symbol"));
+
+        JsonArray *mods = json_object_get_array_member(json_binding_info, "mods");
+        gint mods_len = json_array_get_length(mods);
+
+        for (int i = 0; i < mods_len; i += 1) {
+            e->binding->mods =
+                g_slist_append(e->binding->mods, g_strdup(json_array_get_string_element(mods, i)));
+        }
+
+        ipc_queued_event_set(queued, BINDING, detail, e);
+        break;
+    }
+
+    default:
+        g_warning("got unknown event\n");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Emits the events that the event thread decoded. Stops early when a handler
+ * moves the connection to another source, and the rest stays in the backlog.
+ */
+static void ipc_emit_queued_events(i3ipcConnection *self, GSource *source) {
+    i3ipcQueuedEvent *queued;
+    gboolean batch = ipc_begin_batch(self);
+
+    ipc_event_stack_take(self);
+
+    while (self->priv->sub_source == source &&
+           (queued = g_queue_pop_head(&self->priv->event_backlog)) != NULL) {
+        ipc_emit_event(self, queued->signal, queued->detail, queued->event);
+        g_slice_free(i3ipcQueuedEvent, queued);
+    }
+
+    ipc_end_batch(self, batch);
+}
+
+/*
+ * Decodes the events that are buffered for the subscription socket and pushes
+ * them for the events context. Replies to subscriptions are handed to the
+ * thread that waits for them. Called with the reader role held. Sets @wakeup
+ * when the stack of events was empty, and returns FALSE when the stream is
+ * corrupt.
+ */
+static gboolean ipc_decode_events(i3ipcConnection *self, gboolean *wakeup, GError **err) {
+    uint32_t reply_type;
+    uint32_t reply_length;
+    const gchar *payload;
+
+    while (ipc_framer_next(&self->priv->sub_framer, &reply_type, &payload, &reply_length, err)) {
+        i3ipcQueuedEvent queued;
+
+        if (!(reply_type & I3IPC_EVENT_BIT)) {
+            g_mutex_lock(&self->priv->lock);
+
+            if (self->priv->sub_replies_abandoned > 0) {
+                self->priv->sub_replies_abandoned -= 1;
+            } else {
+                g_queue_push_tail(&self->priv->sub_replies, g_strndup(payload, reply_length));
+                g_cond_broadcast(&self->priv->reply_cond);
+            }
+
+            g_mutex_unlock(&self->priv->lock);
+            continue;
+        }
+
+        if (ipc_decode_event(self, reply_type, payload, reply_length, &queued)) {
+            *wakeup |= ipc_event_stack_push(self, g_slice_dup(i3ipcQueuedEvent, &queued));
+        }
+    }
+
+    return (*err == NULL);
+}
+
+/*
+ * Reads what is available on the subscription socket when @fill is set and
+ * decodes everything that is buffered, for the events context to emit. The
+ * reader role is only held meanwhile, so handlers can subscribe.
+ */
+static GIOStatus ipc_read_events(i3ipcConnection *self, gboolean fill, GError **err) {
+    GIOStatus status = G_IO_STATUS_AGAIN;
+    gboolean wakeup = FALSE;
+
+    ipc_sub_reader_take(self);
+
+    if (fill) {
+        status = ipc_fill_events(self, err);
+    }
+
+    if (*err == NULL) {
+        ipc_decode_events(self, &wakeup, err);
+    }
+
+    ipc_sub_reader_release(self);
+
+    return status;
+}
+
+static void ipc_schedule_reconnect(i3ipcConnection *self);
+
+static void ipc_on_shutdown(i3ipcConnection *self) {
+    g_signal_emit(self, connection_signals[IPC_SHUTDOWN], 0);
+
+    if (self->priv->auto_reconnect) {
+        ipc_schedule_reconnect(self);
+    } else if (self->priv->main_loop != NULL) {
+        i3ipc_connection_main_quit(self);
+    }
+}
+
+static gboolean ipc_event_source_prepare(GSource *source, gint *timeout) {
+    i3ipcEventSource *event_source = (i3ipcEventSource *)source;
+
+    *timeout = -1;
+
+    /* events can be left in the buffer by a subscribe call or a handler */
+    return (ipc_sub_framer_has_message(event_source->conn) ||
+            ipc_has_queued_events(event_source->conn));
+}
+
+static gboolean ipc_event_source_check(GSource *source) {
+    i3ipcEventSource *event_source = (i3ipcEventSource *)source;
+
+    return (g_source_query_unix_fd(source, event_source->fd_tag) != 0 ||
+            ipc_sub_framer_has_message(event_source->conn) ||
+            ipc_has_queued_events(event_source->conn));
+}
+
+/*
+ * Reads everything that is available on the subscription channel without
+ * blocking and emits the signals for every complete event.
+ */
+static gboolean ipc_event_source_dispatch(GSource *source, GSourceFunc callback,
+                                          gpointer user_data) {
+    i3ipcEventSource *event_source = (i3ipcEventSource *)source;
+    i3ipcConnection *self = event_source->conn;
+    GError *err = NULL;
+    gboolean retval = G_SOURCE_CONTINUE;
+    gboolean readable = (g_source_query_unix_fd(source, event_source->fd_tag) != 0);
+    GIOStatus status = ipc_read_events(self, readable, &err);
+
+    /* a handler may drop the last reference to the connection */
+    g_object_ref(self);
+
+    /* stops early when a handler moves the connection to another source */
+    ipc_emit_queued_events(self, source);
+
+    if (err) {
+        g_warning("could not get event reply (%s)\n", err->message);
+        g_error_free(err);
+        status = G_IO_STATUS_ERROR;
+    }
+
+    if (status == G_IO_STATUS_EOF || status == G_IO_STATUS_ERROR) {
+        if (self->priv->sub_source == source) {
+            g_clear_pointer(&self->priv->sub_source, g_source_unref);
+        }
+
+        retval = G_SOURCE_REMOVE;
+        ipc_on_shutdown(self);
+    }
+
+    g_object_unref(self);
+
+    return retval;
+}
+
+static GSourceFuncs ipc_event_source_funcs = {
+    ipc_event_source_prepare,
+    ipc_event_source_check,
+    ipc_event_source_dispatch,
+    NULL,
+};
+
+/*
+ * Decodes the events that are buffered for the event thread and wakes up the
+ * events context once for everything that was read at once.
+ */
+static gboolean ipc_event_reader_decode(i3ipcConnection *self, GError **err) {
+    gboolean wakeup = FALSE;
+    gboolean retval = ipc_decode_events(self, &wakeup, err);
+
+    if (wakeup) {
+        g_main_context_wakeup(self->priv->event_reader_context);
+    }
+
+    return retval;
+}
+
+/*
+ * The event thread. It owns the subscription socket and its framer while it
+ * runs, and does all the reading, parsing and building of the event objects,
+ * so the events context only has to emit the signals.
+ */
+static gpointer ipc_event_reader_run(gpointer user_data) {
+    i3ipcConnection *self = user_data;
+    GCancellable *cancellable = self->priv->event_reader_cancellable;
+    GPollFD pfds[2] = {
+        {.fd = ipc_event_fd(self), .events = G_IO_IN | G_IO_HUP | G_IO_ERR},
+    };
+    GIOStatus status = G_IO_STATUS_NORMAL;
+    GError *err = NULL;
+
+    /* waits for a thread that is still waiting for the reply to a
+     * subscription */
+    ipc_sub_reader_take(self);
+    g_cancellable_make_pollfd(cancellable, &pfds[1]);
+
+    while (ipc_event_reader_decode(self, &err) && status != G_IO_STATUS_EOF) {
+        if (g_poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            g_set_error(&err, G_IO_ERROR, g_io_error_from_errno(errno),
+                        "Could not wait for events (%s)", strerror(errno));
+            break;
+        }
+
+        if (g_cancellable_is_cancelled(cancellable)) {
+            break;
+        }
+
+        if (pfds[0].revents != 0 && (status = ipc_fill_events(self, &err)) == G_IO_STATUS_ERROR) {
+            break;
+        }
+    }
+
+    g_cancellable_release_fd(cancellable);
+
+    if (err != NULL) {
+        g_warning("could not get event reply (%s)\n", err->message);
+        g_error_free(err);
+    }
+
+    g_mutex_lock(&self->priv->lock);
+    self->priv->event_reader_running = FALSE;
+    self->priv->sub_reading = FALSE;
+    /* the thread that waits for the reply to a subscription reads it itself */
+    g_cond_broadcast(&self->priv->reply_cond);
+    g_mutex_unlock(&self->priv->lock);
+
+    if (!g_cancellable_is_cancelled(cancellable)) {
+        /* the events context handles the loss of the connection */
+        g_atomic_int_set(&self->priv->event_reader_failed, TRUE);
+        g_main_context_wakeup(self->priv->event_reader_context);
+    }
+
+    return NULL;
+}
+
+static void ipc_event_reader_start(i3ipcConnection *self, GMainContext *context) {
+    self->priv->event_reader_context = g_main_context_ref(context);
+    self->priv->event_reader_cancellable = g_cancellable_new();
+
+    g_mutex_lock(&self->priv->lock);
+    self->priv->event_reader_running = TRUE;
+    g_mutex_unlock(&self->priv->lock);
+
+    self->priv->event_reader = g_thread_new("i3ipc-events", ipc_event_reader_run, self);
+}
+
+/*
+ * Stops the event thread and waits for it. The events it decoded stay queued,
+ * and what it did not get to stays in the framer.
+ */
+static void ipc_event_reader_stop(i3ipcConnection *self) {
+    if (self->priv->event_reader == NULL) {
+        return;
+    }
+
+    g_cancellable_cancel(self->priv->event_reader_cancellable);
+    g_thread_join(self->priv->event_reader);
+    self->priv->event_reader = NULL;
+
+    g_clear_object(&self->priv->event_reader_cancellable);
+    g_clear_pointer(&self->priv->event_reader_context, g_main_context_unref);
+    g_atomic_int_set(&self->priv->event_reader_failed, FALSE);
+}
+
+static gboolean ipc_queued_source_prepare(GSource *source, gint *timeout) {
+    i3ipcEventSource *event_source = (i3ipcEventSource *)source;
+
+    *timeout = -1;
+
+    return (ipc_has_queued_events(event_source->conn) ||
+            g_atomic_int_get(&event_source->conn->priv->event_reader_failed));
+}
+
+static gboolean ipc_queued_source_check(GSource *source) {
+    gint timeout;
+
+    return ipc_queued_source_prepare(source, &timeout);
+}
+
+/*
+ * Emits the events the event thread decoded. Once the thread stopped because
+ * the connection was lost, this is handled after the last of its events.
+ */
+static gboolean ipc_queued_source_dispatch(GSource *source, GSourceFunc callback,
+                                           gpointer user_data) {
+    i3ipcEventSource *event_source = (i3ipcEventSource *)source;
+    i3ipcConnection *self = event_source->conn;
+    /* read first, so that every event pushed before the failure is emitted */
+    gboolean failed = g_atomic_int_get(&self->priv->event_reader_failed);
+    gboolean retval = G_SOURCE_CONTINUE;
+
+    /* a handler may drop the last reference to the connection */
+    g_object_ref(self);
+
+    ipc_emit_queued_events(self, source);
+
+    if (failed && self->priv->sub_source == source && !ipc_has_queued_events(self)) {
+        g_clear_pointer(&self->priv->sub_source, g_source_unref);
+        retval = G_SOURCE_REMOVE;
+        ipc_on_shutdown(self);
+    }
+
+    g_object_unref(self);
+
+    return retval;
+}
+
+static GSourceFuncs ipc_queued_source_funcs = {
+    ipc_queued_source_prepare,
+    ipc_queued_source_check,
+    ipc_queued_source_dispatch,
+    NULL,
+};
+
+/*
+ * Moves the source that emits the events to @context. Until the subscription
+ * socket is opened, only the context is remembered. With
+ * #i3ipcConnection:event-thread, the event thread is started again to wake up
+ * @context.
+ */
+static void ipc_attach_events(i3ipcConnection *self, GMainContext *context) {
+    i3ipcEventSource *event_source;
+
+    ipc_event_reader_stop(self);
+
+    if (self->priv->sub_source != NULL) {
+        g_source_destroy(self->priv->sub_source);
+        g_clear_pointer(&self->priv->sub_source, g_source_unref);
+    }
+
+    if (context != self->priv->events_context) {
+        g_main_context_ref(context);
+        g_clear_pointer(&self->priv->events_context, g_main_context_unref);
+        self->priv->events_context = context;
+    }
+
+    self->priv->events_detached = FALSE;
+
+    if (self->priv->sub_channel == NULL) {
+        return;
+    }
+
+    if (self->priv->event_thread) {
+        event_source =
+            (i3ipcEventSource *)g_source_new(&ipc_queued_source_funcs, sizeof(i3ipcEventSource));
+        event_source->conn = self;
+        ipc_event_reader_start(self, context);
+    } else {
+        event_source =
+            (i3ipcEventSource *)g_source_new(&ipc_event_source_funcs, sizeof(i3ipcEventSource));
+        event_source->conn = self;
+        event_source->fd_tag = g_source_add_unix_fd((GSource *)event_source, ipc_event_fd(self),
+                                                    G_IO_IN | G_IO_HUP | G_IO_ERR);
+    }
+
+    self->priv->sub_source = (GSource *)event_source;
+    g_source_set_priority(self->priv->sub_source, self->priv->event_priority);
+    g_source_set_name(self->priv->sub_source, "i3ipc events");
+    g_source_attach(self->priv->sub_source, context);
+}
+
+/*
+ * Opens the subscription socket the first time events are asked for, so
+ * clients that only send messages never connect it or watch it.
+ */
+static gboolean ipc_open_events(i3ipcConnection *self, GError **err) {
+    GError *tmp_error = NULL;
+
+    if (self->priv->sub_channel != NULL) {
+        return TRUE;
+    }
+
+    int sub_fd = i3ipc_transport_open(self->priv->transport, &tmp_error);
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+    self->priv->sub_channel = g_io_channel_unix_new(sub_fd);
+
+    g_io_channel_set_encoding(self->priv->sub_channel, NULL, &tmp_error);
+
+    if (tmp_error != NULL) {
+        g_io_channel_shutdown(self->priv->sub_channel, FALSE, NULL);
+        g_clear_pointer(&self->priv->sub_channel, g_io_channel_unref);
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+#ifdef I3IPC_HAVE_IO_URING
+    g_mutex_lock(&self->priv->uring_lock);
+    self->priv->uring = i3ipc_uring_new(sub_fd, self->priv->sub_framer.buf);
+    g_mutex_unlock(&self->priv->uring_lock);
+#endif
+
+    if (!self->priv->events_detached) {
+        ipc_attach_events(self, self->priv->events_context);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Closes a command socket and fails the requests that wait for a reply on it.
+ */
+static void ipc_lane_close(i3ipcConnection *self, i3ipcLane *lane, const GError *error) {
+    GQueue completed = G_QUEUE_INIT;
+
+    g_mutex_lock(&lane->send_lock);
+    g_mutex_lock(&self->priv->lock);
+
+    if (lane->channel != NULL) {
+        /* wakes up the thread that reads the replies, which must be done
+         * with the socket before it is closed */
+        shutdown(g_io_channel_unix_get_fd(lane->channel), SHUT_RDWR);
+
+        while (lane->reading) {
+            g_cond_wait(&self->priv->reply_cond, &self->priv->lock);
+        }
+    }
+
+    if (lane->source != NULL) {
+        g_source_destroy(lane->source);
+        g_clear_pointer(&lane->source, g_source_unref);
+    }
+
+    g_clear_pointer(&lane->parked_context, g_main_context_unref);
+    ipc_fail_pending_locked(self, lane, error, &completed);
+
+    if (lane->channel != NULL) {
+        g_io_channel_shutdown(lane->channel, FALSE, NULL);
+        g_clear_pointer(&lane->channel, g_io_channel_unref);
+    }
+
+    g_byte_array_set_size(lane->framer.buf, 0);
+    lane->framer.offset = 0;
+
+    g_mutex_unlock(&self->priv->lock);
+    g_mutex_unlock(&lane->send_lock);
+
+    ipc_pending_reply_finish_all(&completed);
+}
+
+/*
+ * Closes the subscription socket along with whatever was buffered on it.
+ */
+static void ipc_close_events(i3ipcConnection *self) {
+    ipc_event_reader_stop(self);
+
+    if (self->priv->sub_source != NULL) {
+        g_source_destroy(self->priv->sub_source);
+        g_clear_pointer(&self->priv->sub_source, g_source_unref);
+    }
+
+    if (self->priv->sub_channel != NULL) {
+        /* wakes up a thread that waits for the reply to a subscription, which
+         * must be done with the socket before it is closed */
+        shutdown(g_io_channel_unix_get_fd(self->priv->sub_channel), SHUT_RDWR);
+    }
+
+    ipc_sub_reader_take(self);
+
+#ifdef I3IPC_HAVE_IO_URING
+    g_mutex_lock(&self->priv->uring_lock);
+    g_clear_pointer(&self->priv->uring, i3ipc_uring_free);
+    g_mutex_unlock(&self->priv->uring_lock);
+#endif
+
+    if (self->priv->sub_channel != NULL) {
+        g_io_channel_shutdown(self->priv->sub_channel, FALSE, NULL);
+        g_clear_pointer(&self->priv->sub_channel, g_io_channel_unref);
+    }
+
+    g_byte_array_set_size(self->priv->sub_framer.buf, 0);
+    self->priv->sub_framer.offset = 0;
+
+    ipc_sub_reader_release(self);
+}
+
+/*
+ * Drops all the sockets after the ipc went away, along with whatever was
+ * buffered on them. Requests that wait for a reply fail.
+ */
+static void ipc_close_channels(i3ipcConnection *self) {
+    GError *err = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED,
+                                      "The ipc connection was closed");
+
+    ipc_lane_close(self, &self->priv->cmd_lane, err);
+    ipc_lane_close(self, &self->priv->high_lane, err);
+    g_error_free(err);
+
+    ipc_close_events(self);
+}
+
+/*
+ * Makes one attempt to connect to the ipc again. On success the subscription
+ * socket is opened again if it was open before, the subscriptions are sent
+ * again and #i3ipcConnection::reconnected is emitted. Only runs on the events
+ * context, with the reconnect lock held, so the signal is emitted where the
+ * events are.
+ */
+static gboolean ipc_reconnect(i3ipcConnection *self, GError **err) {
+    GError *tmp_error = NULL;
+    i3ipcEvent subscriptions = ipc_get_subscriptions(self);
+    gboolean had_events = (self->priv->sub_channel != NULL || subscriptions != 0);
+    i3ipcCommandReply *reply;
+    gint64 gap;
+
+    int cmd_fd = i3ipc_transport_open(self->priv->transport, &tmp_error);
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+    ipc_close_channels(self);
+
+    g_mutex_lock(&self->priv->cmd_lane.send_lock);
+    g_mutex_lock(&self->priv->lock);
+    self->priv->cmd_lane.channel = g_io_channel_unix_new(cmd_fd);
+    g_io_channel_set_encoding(self->priv->cmd_lane.channel, NULL, NULL);
+    g_mutex_unlock(&self->priv->lock);
+    g_mutex_unlock(&self->priv->cmd_lane.send_lock);
+
+    if (had_events) {
+        ipc_set_subscriptions(self, 0);
+
+        if (!ipc_open_events(self, &tmp_error)) {
+            ipc_set_subscriptions(self, subscriptions);
+            g_propagate_error(err, tmp_error);
+            return FALSE;
+        }
+    }
+
+    if (subscriptions != 0) {
+        /* a failure here must not start another reconnect */
+        self->priv->reconnecting = TRUE;
+        reply = i3ipc_connection_subscribe(self, subscriptions, &tmp_error);
+        self->priv->reconnecting = FALSE;
+
+        if (reply == NULL || !reply->success) {
+            /* keep them so the next attempt sends them again */
+            ipc_set_subscriptions(self, subscriptions);
+
+            if (tmp_error == NULL) {
+                tmp_error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                                "The subscriptions could not be restored");
+            }
+
+            i3ipc_command_reply_free(reply);
+            g_propagate_error(err, tmp_error);
+            return FALSE;
+        }
+
+        i3ipc_command_reply_free(reply);
+    }
+
+    g_mutex_lock(&self->priv->lock);
+
+    gap = g_get_monotonic_time() - self->priv->disconnected_at;
+    self->priv->disconnected_at = 0;
+    self->priv->reconnect_delay = 0;
+
+    if (self->priv->reconnect_source != NULL) {
+        g_source_destroy(self->priv->reconnect_source);
+        g_clear_pointer(&self->priv->reconnect_source, g_source_unref);
+    }
+
+    self->priv->connected = TRUE;
+    g_atomic_int_inc(&self->priv->generation);
+    /* wakes up the threads that wait for the events context to reconnect */
+    g_cond_broadcast(&self->priv->reply_cond);
+
+    g_mutex_unlock(&self->priv->lock);
+
+    g_object_notify_by_pspec(G_OBJECT(self), obj_properties[PROP_CONNECTED]);
+    g_signal_emit(self, connection_signals[RECONNECTED], 0, gap);
+
+    return TRUE;
+}
+
+static gboolean ipc_schedule_reconnect_locked(i3ipcConnection *self);
+
+static void ipc_on_wait_cancelled(GCancellable *cancellable, gpointer user_data) {
+    i3ipcConnection *self = user_data;
+
+    g_mutex_lock(&self->priv->lock);
+    g_cond_broadcast(&self->priv->reply_cond);
+    g_mutex_unlock(&self->priv->lock);
+}
+
+static gboolean ipc_on_reconnect_timeout(gpointer user_data) {
+    i3ipcConnection *self = user_data;
+    gboolean disconnected;
+
+    g_rec_mutex_lock(&self->priv->reconnect_lock);
+
+    g_mutex_lock(&self->priv->lock);
+    g_clear_pointer(&self->priv->reconnect_source, g_source_unref);
+    /* another thread may have reconnected in the meantime */
+    disconnected = (self->priv->disconnected_at != 0);
+    g_mutex_unlock(&self->priv->lock);
+
+    if (disconnected && !ipc_reconnect(self, NULL)) {
+        g_mutex_lock(&self->priv->lock);
+        self->priv->reconnect_delay =
+            MIN(self->priv->reconnect_delay * 2, I3IPC_RECONNECT_MAX_DELAY);
+        ipc_schedule_reconnect_locked(self);
+        g_mutex_unlock(&self->priv->lock);
+    }
+
+    g_rec_mutex_unlock(&self->priv->reconnect_lock);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean ipc_notify_connected(gpointer user_data) {
+    g_object_notify_by_pspec(G_OBJECT(user_data), obj_properties[PROP_CONNECTED]);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Marks the connection as lost and retries connecting from the context the
+ * events are processed in, with a delay that doubles after every attempt.
+ * Called with the lock held. Returns TRUE when the connection was only lost
+ * now, and the caller has to notify #i3ipcConnection:connected.
+ */
+static gboolean ipc_schedule_reconnect_locked(i3ipcConnection *self) {
+    gboolean lost = FALSE;
+
+    if (self->priv->disconnected_at == 0) {
+        self->priv->disconnected_at = g_get_monotonic_time();
+        self->priv->reconnect_delay = I3IPC_RECONNECT_MIN_DELAY;
+        self->priv->connected = FALSE;
+        lost = TRUE;
+    }
+
+    if (self->priv->reconnect_source == NULL) {
+        self->priv->reconnect_source = g_timeout_source_new(self->priv->reconnect_delay);
+        g_source_set_callback(self->priv->reconnect_source, ipc_on_reconnect_timeout, self,
+                              NULL);
+        g_source_set_name(self->priv->reconnect_source, "i3ipc reconnect");
+        g_source_attach(self->priv->reconnect_source, self->priv->events_context);
+    }
+
+    return lost;
+}
+
+/*
+ * Notifies that the connection was lost from the events context, since this
+ * may be called from any thread.
+ */
+static void ipc_notify_lost(i3ipcConnection *self) {
+    g_main_context_invoke_full(self->priv->events_context, G_PRIORITY_DEFAULT,
+                               ipc_notify_connected, g_object_ref(self), g_object_unref);
+}
+
+static void ipc_schedule_reconnect(i3ipcConnection *self) {
+    gboolean lost;
+
+    g_mutex_lock(&self->priv->lock);
+    lost = ipc_schedule_reconnect_locked(self);
+    g_mutex_unlock(&self->priv->lock);
+
+    if (lost) {
+        ipc_notify_lost(self);
+    }
+}
+
+/*
+ * Reconnects for a synchronous message that found the ipc gone, waiting a
+ * little for the ipc to come back. The attempts are made on the events
+ * context: right here when this thread can acquire it, or else by the thread
+ * that runs it while this one waits. @generation is the one the message saw
+ * before it failed, so when several threads find the ipc gone at once only
+ * the first one reconnects. Gives up early when @deadline passes or
+ * @cancellable is cancelled.
+ */
+static gboolean ipc_reconnect_sync(i3ipcConnection *self, guint generation, gint64 deadline,
+                                   GCancellable *cancellable, GError **err) {
+    gint64 limit = g_get_monotonic_time() + I3IPC_RECONNECT_SYNC_TIMEOUT * 1000;
+    GMainContext *context = self->priv->events_context;
+    guint delay = I3IPC_RECONNECT_MIN_DELAY;
+    GError *tmp_error = NULL;
+    gboolean reconnected = FALSE;
+    gboolean lost = FALSE;
+    gulong cancel_id = 0;
+    gint64 until;
+
+    if (deadline >= 0) {
+        limit = MIN(limit, deadline);
+    }
+
+    if (cancellable != NULL) {
+        cancel_id = g_cancellable_connect(cancellable, G_CALLBACK(ipc_on_wait_cancelled), self,
+                                          NULL);
+    }
+
+    do {
+        if (g_main_context_acquire(context)) {
+            g_rec_mutex_lock(&self->priv->reconnect_lock);
+
+            if (g_atomic_int_get(&self->priv->generation) == generation) {
+                ipc_schedule_reconnect(self);
+                g_clear_error(&tmp_error);
+                ipc_reconnect(self, &tmp_error);
+            }
+
+            g_rec_mutex_unlock(&self->priv->reconnect_lock);
+            g_main_context_release(context);
+        }
+
+        until = MIN(g_get_monotonic_time() + delay * 1000, limit);
+        delay = MIN(delay * 2, I3IPC_RECONNECT_MAX_DELAY);
+
+        g_mutex_lock(&self->priv->lock);
+
+        if (g_atomic_int_get(&self->priv->generation) == generation) {
+            /* makes sure the events context retries when this thread can not */
+            lost |= ipc_schedule_reconnect_locked(self);
+        }
+
+        while (!(reconnected = (g_atomic_int_get(&self->priv->generation) != generation)) &&
+               !g_cancellable_is_cancelled(cancellable) &&
+               g_cond_wait_until(&self->priv->reply_cond, &self->priv->lock, until)) {
+        }
+
+        g_mutex_unlock(&self->priv->lock);
+    } while (!reconnected && !g_cancellable_is_cancelled(cancellable) && until < limit);
+
+    if (cancel_id != 0) {
+        g_cancellable_disconnect(cancellable, cancel_id);
+    }
+
+    if (lost) {
+        ipc_notify_lost(self);
+    }
+
+    if (reconnected) {
+        g_clear_error(&tmp_error);
+        return TRUE;
+    }
+
+    if (g_cancellable_is_cancelled(cancellable)) {
+        g_clear_error(&tmp_error);
+        g_cancellable_set_error_if_cancelled(cancellable, &tmp_error);
+    } else if (tmp_error == NULL) {
+        tmp_error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                                        "Timed out waiting for the ipc to come back");
+    }
+
+    g_propagate_error(err, tmp_error);
+
+    return FALSE;
+}
+
+/*
+ * Whether a synchronous message that found the ipc gone may reconnect and try
+ * again.
+ */
+static gboolean ipc_can_reconnect_sync(i3ipcConnection *self) {
+    return (self->priv->auto_reconnect && !self->priv->reconnecting);
+}
+
+/*
+ * Whether @error means the ipc went away before it got the message, so that
+ * it can be sent again after reconnecting.
+ */
+static gboolean ipc_error_is_disconnect(const GError *error) {
+    return (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE) ||
+            g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED) ||
+            g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED));
+}
+
+/*
+ * Converts a timeout in milliseconds to a deadline in monotonic time. A
+ * negative timeout gives a deadline of -1, which never passes.
+ */
+static gint64 ipc_deadline(gint timeout) {
+    return (timeout < 0 ? -1 : g_get_monotonic_time() + (gint64)timeout * 1000);
+}
+
+/*
+ * Waits for @fd to meet @condition, which is G_IO_IN or G_IO_OUT. Fails with
+ * G_IO_ERROR_TIMED_OUT once @deadline passes and with G_IO_ERROR_CANCELLED
+ * when @cancellable is cancelled.
+ */
+static gboolean ipc_wait_fd(int fd, GIOCondition condition, gint64 deadline,
+                            GCancellable *cancellable, GError **err) {
+    GPollFD pfds[2] = {
+        {.fd = fd, .events = condition | G_IO_HUP | G_IO_ERR},
+    };
+    guint n_pfds = 1;
+    gint timeout = -1;
+    gint ret;
+
+    if (g_cancellable_set_error_if_cancelled(cancellable, err)) {
+        return FALSE;
+    }
+
+    if (g_cancellable_make_pollfd(cancellable, &pfds[1])) {
+        n_pfds = 2;
+    }
+
+    do {
+        if (deadline >= 0) {
+            timeout = MAX((deadline - g_get_monotonic_time() + 999) / 1000, 0);
+        }
+
+        ret = g_poll(pfds, n_pfds, timeout);
+    } while (ret < 0 && errno == EINTR);
+
+    if (n_pfds == 2) {
+        g_cancellable_release_fd(cancellable);
+    }
+
+    if (ret < 0) {
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "Could not wait for the ipc (%s)", strerror(errno));
+        return FALSE;
+    }
+
+    if (g_cancellable_set_error_if_cancelled(cancellable, err)) {
+        return FALSE;
+    }
+
+    if (ret == 0) {
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                            (condition == G_IO_OUT ? "Timed out sending to i3"
+                                                   : "Timed out waiting for the reply"));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * While another thread reads the subscription socket, it hands the reply to a
+ * subscription over. Returns FALSE when nobody else reads, in which case the
+ * caller takes the reader role and has to read the reply itself.
+ */
+static gboolean ipc_wait_for_handed_reply(i3ipcConnection *self, gint64 deadline,
+                                          GCancellable *cancellable, gchar **reply,
+                                          GError **err) {
+    gulong cancel_id = 0;
+
+    if (cancellable != NULL) {
+        cancel_id = g_cancellable_connect(cancellable, G_CALLBACK(ipc_on_wait_cancelled), self,
+                                          NULL);
+    }
+
+    g_mutex_lock(&self->priv->lock);
+
+    while ((*reply = g_queue_pop_head(&self->priv->sub_replies)) == NULL &&
+           (self->priv->event_reader_running || self->priv->sub_reading)) {
+        if (g_cancellable_set_error_if_cancelled(cancellable, err)) {
+            break;
+        }
+
+        if (deadline < 0) {
+            g_cond_wait(&self->priv->reply_cond, &self->priv->lock);
+        } else if (!g_cond_wait_until(&self->priv->reply_cond, &self->priv->lock, deadline) &&
+                   g_queue_is_empty(&self->priv->sub_replies)) {
+            g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                                "Timed out waiting for the reply");
+            break;
+        }
+    }
+
+    if (*err != NULL) {
+        /* the reader drops the reply when it arrives */
+        self->priv->sub_replies_abandoned += 1;
+    } else if (*reply == NULL) {
+        self->priv->sub_reading = TRUE;
+    }
+
+    g_mutex_unlock(&self->priv->lock);
+
+    if (cancel_id != 0) {
+        g_cancellable_disconnect(cancellable, cancel_id);
+    }
+
+    return (*reply != NULL || *err != NULL);
+}
+
+/*
+ * Blocks until the reply to a message on the subscription channel arrives.
+ * Events that arrive before it stay buffered and are emitted by the event
+ * source afterwards. When the wait is given up, the reply is discarded
+ * whenever it arrives.
+ */
+static gchar *ipc_wait_for_sub_reply(i3ipcConnection *self, gint64 deadline,
+                                     GCancellable *cancellable, GError **err) {
+    GError *tmp_error = NULL;
+    GIOStatus status;
+    gchar *reply = NULL;
+    i3ipcFramer *framer = &self->priv->sub_framer;
+
+    while (tmp_error == NULL) {
+        if (ipc_wait_for_handed_reply(self, deadline, cancellable, &reply, &tmp_error)) {
+            break;
+        }
+
+        /* this thread is the reader now */
+        reply = ipc_framer_take_reply(framer, &tmp_error);
+
+        if (reply == NULL && tmp_error == NULL &&
+            ipc_wait_fd(ipc_event_fd(self), G_IO_IN, deadline, cancellable, &tmp_error)) {
+            status = ipc_fill_events(self, &tmp_error);
+
+            if (status == G_IO_STATUS_EOF) {
+                g_set_error_literal(&tmp_error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED,
+                                    "The ipc connection was closed");
+            }
+        }
+
+        g_mutex_lock(&self->priv->lock);
+
+        if (reply != NULL && self->priv->sub_replies_abandoned > 0) {
+            /* the late reply to a subscription that was given up on */
+            self->priv->sub_replies_abandoned -= 1;
+            g_clear_pointer(&reply, g_free);
+        } else if (reply == NULL && tmp_error != NULL) {
+            self->priv->sub_replies_abandoned += 1;
+        }
+
+        g_mutex_unlock(&self->priv->lock);
+
+        ipc_sub_reader_release(self);
+
+        if (reply != NULL) {
+            break;
+        }
+    }
+
+    if (self->priv->events_context != NULL) {
+        /* the events that came before the reply are left in the framer */
+        g_main_context_wakeup(self->priv->events_context);
+    }
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return NULL;
+    }
+
+    return reply;
+}
+
+/*
+ * Finds the ipc and connects the command socket. This is the part of the
+ * initialization that blocks, so the asynchronous initialization runs it in a
+ * thread. The subscription socket is opened by ipc_open_events() when needed.
+ */
+static gboolean ipc_connect(i3ipcConnection *self, GCancellable *cancellable, GError **err) {
+    GError *tmp_error = NULL;
+    gboolean discovered = (self->priv->transport == NULL && self->priv->socket_path == NULL);
+
+    if (g_cancellable_set_error_if_cancelled(cancellable, err)) {
+        return FALSE;
+    }
+
+    if (self->priv->transport == NULL) {
+        self->priv->socket_path = i3ipc_connection_get_socket_path(self, &tmp_error);
+
+        if (tmp_error != NULL) {
+            g_propagate_error(err, tmp_error);
+            return FALSE;
+        }
+
+        self->priv->transport = i3ipc_unix_transport_new(self->priv->socket_path);
+    } else if (self->priv->socket_path == NULL && I3IPC_IS_UNIX_TRANSPORT(self->priv->transport)) {
+        self->priv->socket_path = g_strdup(
+            i3ipc_unix_transport_get_socket_path(I3IPC_UNIX_TRANSPORT(self->priv->transport)));
+    }
+
+    int cmd_fd = i3ipc_transport_open(self->priv->transport, &tmp_error);
+
+    if (tmp_error != NULL && discovered) {
+        /* the path may be left over from a window manager that is gone */
+        gchar *stale_path = self->priv->socket_path;
+
+        i3ipc_discovery_forget(stale_path);
+        self->priv->socket_path = i3ipc_discover_socket_path(NULL);
+
+        if (self->priv->socket_path != NULL &&
+            g_strcmp0(self->priv->socket_path, stale_path) != 0) {
+            g_clear_error(&tmp_error);
+            g_object_unref(self->priv->transport);
+            self->priv->transport = i3ipc_unix_transport_new(self->priv->socket_path);
+            cmd_fd = i3ipc_transport_open(self->priv->transport, &tmp_error);
+        }
+
+        g_free(stale_path);
+    }
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+    self->priv->cmd_lane.channel = g_io_channel_unix_new(cmd_fd);
+
+    g_io_channel_set_encoding(self->priv->cmd_lane.channel, NULL, &tmp_error);
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Records the outcome of the initialization. The events are emitted from
+ * @context, the thread-default context of whoever started it.
+ */
+static void ipc_init_done(i3ipcConnection *self, GMainContext *context, GError *error) {
+    self->priv->init_state = IPC_INIT_DONE;
+
+    if (error != NULL) {
+        self->priv->init_error = error;
+        return;
+    }
+
+    self->priv->events_context = g_main_context_ref(context);
+    self->priv->connected = TRUE;
+}
+
+/*
+ * Connects a connection that was created with g_object_new() on first use.
+ * Returns FALSE and sets @err if it cannot be used.
+ */
+static gboolean ipc_ensure_init(i3ipcConnection *self, GError **err) {
+    if (self->priv->init_state == IPC_INIT_DONE && self->priv->init_error == NULL) {
+        return TRUE;
+    }
+
+    return g_initable_init(G_INITABLE(self), NULL, err);
+}
+
+static gboolean i3ipc_connection_initable_init(GInitable *initable, GCancellable *cancellable,
+                                               GError **err) {
+    i3ipcConnection *self = I3IPC_CONNECTION(initable);
     GError *tmp_error = NULL;
-    gchar *sock = g_strdup(socket_path);
+    GMainContext *context;
+
+    g_return_val_if_fail(err == NULL || *err == NULL, FALSE);
 
-    if (!sock) {
-	    sock = getenv("I3SOCK");
+    if (self->priv->init_state == IPC_INIT_RUNNING) {
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_PENDING,
+                            "The connection is still being initialized");
+        return FALSE;
     }
 
-    conn =
-        g_initable_new(I3IPC_TYPE_CONNECTION, NULL, &tmp_error, "socket-path", sock, NULL);
+    if (self->priv->init_state == IPC_INIT_NONE) {
+        self->priv->init_state = IPC_INIT_RUNNING;
+        ipc_connect(self, cancellable, &tmp_error);
 
-    if (tmp_error != NULL) {
-        g_propagate_error(err, tmp_error);
-        return NULL;
+        context = g_main_context_ref_thread_default();
+        ipc_init_done(self, context, tmp_error);
+        g_main_context_unref(context);
     }
 
-    return conn;
+    if (self->priv->init_error != NULL) {
+        g_propagate_error(err, g_error_copy(self->priv->init_error));
+        return FALSE;
+    }
+
+    return TRUE;
 }
 
-static gchar *i3ipc_connection_get_socket_path(i3ipcConnection *self, GError **err) {
+static void i3ipc_connection_initable_iface_init(GInitableIface *iface) {
+    iface->init = i3ipc_connection_initable_init;
+}
+
+static void ipc_connect_thread(GTask *task, gpointer source_object, gpointer task_data,
+                               GCancellable *cancellable) {
     GError *tmp_error = NULL;
-    xcb_intern_atom_reply_t *atom_reply;
-    gchar *socket_path;
-    const char *atomname = "I3_SOCKET_PATH";
-    size_t content_max_words = 256;
-    xcb_screen_t *screen;
-    xcb_intern_atom_cookie_t atom_cookie;
-    xcb_window_t root;
-    xcb_get_property_cookie_t prop_cookie;
-    xcb_get_property_reply_t *prop_reply;
 
-    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+    if (!ipc_connect(I3IPC_CONNECTION(source_object), cancellable, &tmp_error)) {
+        g_task_return_error(task, tmp_error);
+        return;
+    }
 
-    if (self->priv->socket_path != NULL) {
-        return self->priv->socket_path;
+    g_task_return_boolean(task, TRUE);
+}
+
+static void ipc_on_connected(GObject *source, GAsyncResult *result, gpointer user_data) {
+    i3ipcConnection *self = I3IPC_CONNECTION(source);
+    GTask *task = user_data;
+    GError *tmp_error = NULL;
+
+    g_task_propagate_boolean(G_TASK(result), &tmp_error);
+
+    /* this runs in the context the initialization was started from */
+    ipc_init_done(self, g_task_get_context(task), tmp_error);
+
+    if (self->priv->init_error != NULL) {
+        g_task_return_error(task, g_error_copy(self->priv->init_error));
+    } else {
+        g_task_return_boolean(task, TRUE);
+    }
+
+    g_object_unref(task);
+}
+
+static void i3ipc_connection_init_async(GAsyncInitable *initable, int io_priority,
+                                        GCancellable *cancellable, GAsyncReadyCallback callback,
+                                        gpointer user_data) {
+    i3ipcConnection *self = I3IPC_CONNECTION(initable);
+    GTask *task;
+    GTask *connect_task;
+
+    task = g_task_new(self, cancellable, callback, user_data);
+    g_task_set_source_tag(task, i3ipc_connection_init_async);
+    g_task_set_priority(task, io_priority);
+
+    if (self->priv->init_state == IPC_INIT_RUNNING) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_PENDING,
+                                "The connection is still being initialized");
+        g_object_unref(task);
+        return;
     }
 
-    xcb_connection_t *conn = xcb_connect(NULL, NULL);
+    if (self->priv->init_state == IPC_INIT_DONE) {
+        if (self->priv->init_error != NULL) {
+            g_task_return_error(task, g_error_copy(self->priv->init_error));
+        } else {
+            g_task_return_boolean(task, TRUE);
+        }
 
-    screen = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+        g_object_unref(task);
+        return;
+    }
 
-    root = screen->root;
+    /* the lookup of the socket and the connect() block, so they run in a thread */
+    self->priv->init_state = IPC_INIT_RUNNING;
+    connect_task = g_task_new(self, cancellable, ipc_on_connected, task);
+    g_task_set_priority(connect_task, io_priority);
+    g_task_run_in_thread(connect_task, ipc_connect_thread);
+    g_object_unref(connect_task);
+}
 
-    atom_cookie = xcb_intern_atom(conn, 0, strlen(atomname), atomname);
-    atom_reply = xcb_intern_atom_reply(conn, atom_cookie, NULL);
+static gboolean i3ipc_connection_init_finish(GAsyncInitable *initable, GAsyncResult *result,
+                                             GError **err) {
+    g_return_val_if_fail(g_task_is_valid(result, initable), FALSE);
 
-    if (atom_reply == NULL) {
-        /* TODO i3ipc custom errors */
-        g_free(atom_reply);
-        tmp_error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "socket path atom reply is null");
-        g_propagate_error(err, tmp_error);
+    return g_task_propagate_boolean(G_TASK(result), err);
+}
+
+static void i3ipc_connection_async_initable_iface_init(GAsyncInitableIface *iface) {
+    iface->init_async = i3ipc_connection_init_async;
+    iface->init_finish = i3ipc_connection_init_finish;
+}
+
+#ifdef I3IPC_HAVE_IO_URING
+/*
+ * Takes the ring for a request on the command channel. Its completions also
+ * feed the buffer of the events, so it is only used while the context the
+ * events are dispatched from can be acquired and nobody else reads the
+ * events, and by one thread at a time. Returns NULL when the plain syscalls
+ * have to be used instead.
+ */
+static i3ipcUring *ipc_uring_acquire(i3ipcConnection *self) {
+    GMainContext *context = self->priv->events_context;
+
+    if (self->priv->uring == NULL || self->priv->events_detached || context == NULL) {
+        return NULL;
+    }
+
+    if (!g_mutex_trylock(&self->priv->uring_lock)) {
+        return NULL;
+    }
+
+    if (self->priv->uring == NULL || !g_main_context_acquire(context)) {
+        g_mutex_unlock(&self->priv->uring_lock);
+        return NULL;
+    }
+
+    g_mutex_lock(&self->priv->lock);
+
+    if (self->priv->sub_reading) {
+        g_mutex_unlock(&self->priv->lock);
+        g_main_context_release(context);
+        g_mutex_unlock(&self->priv->uring_lock);
         return NULL;
     }
 
-    prop_cookie = xcb_get_property_unchecked(conn, FALSE,               /* _delete */
-                                             root,                      /* window */
-                                             atom_reply->atom,          /* property */
-                                             XCB_GET_PROPERTY_TYPE_ANY, /* type */
-                                             0,                         /* long_offset */
-                                             content_max_words          /* long_length */
-    );
+    self->priv->sub_reading = TRUE;
+    g_mutex_unlock(&self->priv->lock);
+
+    return self->priv->uring;
+}
+
+static void ipc_uring_release(i3ipcConnection *self) {
+    ipc_sub_reader_release(self);
+    g_main_context_release(self->priv->events_context);
+    g_mutex_unlock(&self->priv->uring_lock);
+}
+#endif
+
+static gssize ipc_sendmsg(i3ipcConnection *self, int fd, const struct msghdr *msg, int flags) {
+#ifdef I3IPC_HAVE_IO_URING
+    i3ipcUring *uring = ipc_uring_acquire(self);
+
+    if (uring != NULL) {
+        gssize n = i3ipc_uring_sendmsg(uring, fd, msg, flags | MSG_NOSIGNAL);
+        int saved_errno = errno;
+
+        ipc_uring_release(self);
+        errno = saved_errno;
+
+        return n;
+    }
+#endif
+
+    return sendmsg(fd, msg, flags | MSG_NOSIGNAL);
+}
+
+/*
+ * Writes the iovecs to the socket, continuing after partial writes. The array
+ * is advanced in place as the data goes out, and the entries that went out
+ * completely are left empty. When the socket is full, waits for room until
+ * @deadline passes or @cancellable is cancelled.
+ */
+static gboolean ipc_send_iov(i3ipcConnection *self, int fd, struct iovec *iov, gsize iovcnt,
+                             gint64 deadline, GCancellable *cancellable, GError **err) {
+    struct msghdr msg;
+    /* without a deadline the write may as well block */
+    int flags = (deadline < 0 && cancellable == NULL ? 0 : MSG_DONTWAIT);
+
+    while (iovcnt > 0 && iov->iov_len == 0) {
+        iov += 1;
+        iovcnt -= 1;
+    }
+
+    while (iovcnt > 0) {
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = MIN(iovcnt, IOV_MAX);
+
+        ssize_t n = ipc_sendmsg(self, fd, &msg, flags);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!ipc_wait_fd(fd, G_IO_OUT, deadline, cancellable, err)) {
+                    return FALSE;
+                }
+
+                continue;
+            }
+
+            g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                        "Could not send to i3 (%s)", strerror(errno));
+            return FALSE;
+        }
+
+        while (iovcnt > 0 && (gsize)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov->iov_len = 0;
+            iov += 1;
+            iovcnt -= 1;
+        }
+
+        if (iovcnt > 0) {
+            iov->iov_base = (guint8 *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Fills in the header for a message with the given payload. Fails when the
+ * payload does not fit in a message.
+ */
+static gboolean ipc_header_init(i3_ipc_header_t *header, uint32_t message_type,
+                                const struct iovec *payload, gint n_payload, GError **err) {
+    guint64 size = 0;
+
+    for (gint i = 0; i < n_payload; i += 1) {
+        size += payload[i].iov_len;
+    }
+
+    if (size > G_MAXUINT32) {
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                            "The message is too large");
+        return FALSE;
+    }
+
+    memcpy(header->magic, I3IPC_MAGIC, strlen(I3IPC_MAGIC));
+    header->size = size;
+    header->type = message_type;
+
+    return TRUE;
+}
+
+/*
+ * Sends a message to the ipc. The header and the payload go out with a single
+ * syscall unless the socket is full. When the message only went out in part,
+ * the stream is out of step, so the socket is shut down and its reader fails
+ * everything that waits on it.
+ */
+static gboolean ipc_send_message_v(i3ipcConnection *self, int fd, uint32_t message_type,
+                                   const struct iovec *payload, gint n_payload, gint64 deadline,
+                                   GCancellable *cancellable, GError **err) {
+    i3_ipc_header_t header;
+    struct iovec stack_iov[8];
+    struct iovec *iov = stack_iov;
+    gboolean retval;
+
+    if (!ipc_header_init(&header, message_type, payload, n_payload, err)) {
+        return FALSE;
+    }
+
+    if (n_payload + 1 > (gint)G_N_ELEMENTS(stack_iov)) {
+        iov = g_new(struct iovec, n_payload + 1);
+    }
+
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(i3_ipc_header_t);
+    memcpy(iov + 1, payload, n_payload * sizeof(struct iovec));
+
+    retval = ipc_send_iov(self, fd, iov, n_payload + 1, deadline, cancellable, err);
+
+    if (!retval && iov[0].iov_len < sizeof(i3_ipc_header_t)) {
+        shutdown(fd, SHUT_RDWR);
+    }
+
+    if (iov != stack_iov) {
+        g_free(iov);
+    }
+
+    return retval;
+}
+
+/*
+ * Reads what is available on the socket of @lane into its framer. With
+ * @block, waits until there is something to read first.
+ */
+static GIOStatus ipc_fill_replies(i3ipcConnection *self, i3ipcLane *lane, gboolean block,
+                                  GError **err) {
+    i3ipcFramer *framer = &lane->framer;
+    int fd = g_io_channel_unix_get_fd(lane->channel);
+    GPollFD pfd = {.fd = fd, .events = G_IO_IN | G_IO_HUP | G_IO_ERR};
+
+#ifdef I3IPC_HAVE_IO_URING
+    i3ipcUring *uring = (block ? ipc_uring_acquire(self) : NULL);
+
+    if (uring != NULL) {
+        /* waiting and reading takes a single io_uring_enter */
+        const gsize chunk_size = 65536;
+        guint len;
+        gssize n;
+
+        ipc_framer_compact(framer);
+        len = framer->buf->len;
+        g_byte_array_set_size(framer->buf, len + chunk_size);
+
+        do {
+            n = i3ipc_uring_recv(uring, fd, framer->buf->data + len, chunk_size, 0);
+        } while (n < 0 && errno == EINTR);
+
+        ipc_uring_release(self);
+        g_byte_array_set_size(framer->buf, len + MAX(n, 0));
+
+        if (n < 0) {
+            g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                        "Could not read from i3 (%s)", strerror(errno));
+            return G_IO_STATUS_ERROR;
+        }
+
+        return (n == 0 ? G_IO_STATUS_EOF : G_IO_STATUS_NORMAL);
+    }
+#endif
+
+    while (block && g_poll(&pfd, 1, -1) < 0) {
+        if (errno != EINTR) {
+            g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                        "Could not wait for the reply (%s)", strerror(errno));
+            return G_IO_STATUS_ERROR;
+        }
+    }
+
+    return ipc_framer_fill(framer, fd, err);
+}
+
+static void ipc_watch_replies(i3ipcConnection *self, GMainContext *context);
+
+/*
+ * Gives up the reader role of @lane, with the lock held. The watch for the
+ * replies to asynchronous requests that was parked meanwhile is armed again.
+ */
+static void ipc_lane_release_reader(i3ipcConnection *self, i3ipcLane *lane) {
+    GMainContext *context = lane->parked_context;
+
+    lane->reading = FALSE;
+    lane->parked_context = NULL;
+
+    if (context != NULL) {
+        if (lane->channel != NULL && !g_queue_is_empty(lane->pending)) {
+            ipc_watch_replies(self, context);
+        }
+
+        g_main_context_unref(context);
+    }
+
+    /* lets another thread take over reading */
+    g_cond_broadcast(&self->priv->reply_cond);
+}
+
+/*
+ * Reads the replies that are available on @lane and hands them to the
+ * requests that are waiting for them. With @block, waits for at least
+ * some data first.
+ *
+ * Only the thread that holds the reader role reads from the socket, and it
+ * does so without the lock. The lock is only taken to match the replies with
+ * the queue.
+ */
+static void ipc_read_replies(i3ipcConnection *self, i3ipcLane *lane, gboolean block) {
+    GError *err = NULL;
+    GIOStatus status;
+    uint32_t reply_type;
+    uint32_t reply_length;
+    const gchar *payload;
+    i3ipcFramer *framer = &lane->framer;
+    GQueue completed = G_QUEUE_INIT;
+
+    status = ipc_fill_replies(self, lane, block, &err);
+
+    if (status == G_IO_STATUS_EOF) {
+        err = g_error_new(G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED, "The ipc connection was closed");
+
+        if (self->priv->auto_reconnect) {
+            ipc_schedule_reconnect(self);
+        }
+    }
+
+    g_mutex_lock(&self->priv->lock);
+
+    while (err == NULL && ipc_framer_next(framer, &reply_type, &payload, &reply_length, &err)) {
+        i3ipcPendingReply *entry = g_queue_pop_head(lane->pending);
+
+        if (entry == NULL) {
+            g_warning("got a reply without a request\n");
+            continue;
+        }
+
+        if (reply_type != entry->message_type) {
+            err = g_error_new(G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                              "Got a reply of type %u to a request of type %u", reply_type,
+                              entry->message_type);
+            ipc_pending_reply_resolve(entry, NULL, g_error_copy(err), &completed);
+            break;
+        }
+
+        /* the entry is off the queue before any callback can run */
+        entry->reply_length = reply_length;
+        ipc_pending_reply_resolve(entry, g_strndup(payload, reply_length), NULL, &completed);
+    }
+
+    if (err != NULL) {
+        /* the stream cannot be resynchronized after a bad read */
+        g_byte_array_set_size(framer->buf, 0);
+        framer->offset = 0;
+        ipc_fail_pending_locked(self, lane, err, &completed);
+        g_error_free(err);
+    }
+
+    g_cond_broadcast(&self->priv->reply_cond);
+    g_mutex_unlock(&self->priv->lock);
+
+    ipc_pending_reply_finish_all(&completed);
+}
+
+/*
+ * Reads the replies that are available without blocking, unless another
+ * thread is reading them already. Returns FALSE when nothing was read.
+ */
+static gboolean ipc_try_read_replies(i3ipcConnection *self, i3ipcLane *lane) {
+    g_mutex_lock(&self->priv->lock);
+
+    if (lane->reading || lane->channel == NULL) {
+        g_mutex_unlock(&self->priv->lock);
+        return FALSE;
+    }
+
+    lane->reading = TRUE;
+    g_mutex_unlock(&self->priv->lock);
+
+    ipc_read_replies(self, lane, FALSE);
+
+    g_mutex_lock(&self->priv->lock);
+    ipc_lane_release_reader(self, lane);
+    g_mutex_unlock(&self->priv->lock);
+
+    return TRUE;
+}
+
+static gboolean ipc_on_reply_data(gint fd, GIOCondition condition, gpointer user_data) {
+    i3ipcConnection *self = user_data;
+    i3ipcLane *lane = &self->priv->cmd_lane;
+    gboolean retval = G_SOURCE_CONTINUE;
+
+    /* a completed request may drop the last reference to the connection */
+    g_object_ref(self);
+
+    ipc_try_read_replies(self, lane);
+
+    g_mutex_lock(&self->priv->lock);
+
+    if (lane->source != NULL && lane->reading) {
+        /* the socket stays readable until the thread that reads is done with
+         * it, so the watch is parked until then instead of firing again */
+        g_clear_pointer(&lane->parked_context, g_main_context_unref);
+        lane->parked_context = g_main_context_ref(g_source_get_context(lane->source));
+        g_clear_pointer(&lane->source, g_source_unref);
+        retval = G_SOURCE_REMOVE;
+    } else if (g_queue_is_empty(lane->pending) && lane->source != NULL) {
+        g_clear_pointer(&lane->source, g_source_unref);
+        retval = G_SOURCE_REMOVE;
+    }
+
+    g_mutex_unlock(&self->priv->lock);
+
+    g_object_unref(self);
+
+    return retval;
+}
+
+/*
+ * Makes sure the replies to asynchronous requests are read from @context.
+ * While another thread reads, the watch is parked until it is done. Called
+ * with the lock held.
+ */
+static void ipc_watch_replies(i3ipcConnection *self, GMainContext *context) {
+    i3ipcLane *lane = &self->priv->cmd_lane;
+
+    if (lane->source != NULL || lane->parked_context != NULL) {
+        return;
+    }
+
+    if (lane->reading) {
+        lane->parked_context = g_main_context_ref(context);
+        return;
+    }
+
+    lane->source = g_unix_fd_source_new(g_io_channel_unix_get_fd(lane->channel),
+                                        G_IO_IN | G_IO_HUP | G_IO_ERR);
+    g_source_set_callback(lane->source, (GSourceFunc)ipc_on_reply_data, self, NULL);
+    g_source_attach(lane->source, context);
+}
+
+/*
+ * Opens the socket of a lane that is only connected once it is used. Called
+ * with the send lock of the lane held.
+ */
+static gboolean ipc_lane_open(i3ipcConnection *self, i3ipcLane *lane, GError **err) {
+    GIOChannel *channel;
+    int fd = i3ipc_transport_open(self->priv->transport, err);
+
+    if (fd < 0) {
+        return FALSE;
+    }
+
+    channel = g_io_channel_unix_new(fd);
+    g_io_channel_set_encoding(channel, NULL, NULL);
+
+    g_mutex_lock(&self->priv->lock);
+    lane->channel = channel;
+    g_mutex_unlock(&self->priv->lock);
+
+    return TRUE;
+}
+
+/*
+ * Queues @entry on @lane and sends its message. Both happen under the send
+ * lock of the lane, so the order of the queue is the order on the wire even
+ * when several threads send at once, and a reply that comes back right away
+ * finds its entry. On failure the entry is taken off the queue again, and a
+ * socket that got part of the message is shut down.
+ */
+static gboolean ipc_send_request(i3ipcConnection *self, i3ipcLane *lane, i3ipcPendingReply *entry,
+                                 const struct iovec *payload, gint n_payload, gint64 deadline,
+                                 GCancellable *cancellable, GError **err) {
+    GError *tmp_error = NULL;
+    GQueue completed = G_QUEUE_INIT;
+
+    g_mutex_lock(&lane->send_lock);
+
+    if (lane->channel == NULL && lane == &self->priv->high_lane && self->priv->connected) {
+        ipc_lane_open(self, lane, &tmp_error);
+    } else if (lane->channel == NULL) {
+        tmp_error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                                        "The ipc connection was closed");
+    }
+
+    if (tmp_error != NULL) {
+        g_mutex_unlock(&lane->send_lock);
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+    g_mutex_lock(&self->priv->lock);
+    g_queue_push_tail(lane->pending, ipc_pending_reply_ref(entry));
+    g_mutex_unlock(&self->priv->lock);
+
+    ipc_send_message_v(self, g_io_channel_unix_get_fd(lane->channel), entry->message_type,
+                       payload, n_payload, deadline, cancellable, &tmp_error);
+
+    g_mutex_unlock(&lane->send_lock);
+
+    if (tmp_error == NULL) {
+        return TRUE;
+    }
+
+    g_mutex_lock(&self->priv->lock);
 
-    prop_reply = xcb_get_property_reply(conn, prop_cookie, NULL);
-    int len = xcb_get_property_value_length(prop_reply);
-
-    if (prop_reply == NULL || len == 0) {
-        /* TODO i3ipc custom errors */
-        g_free(atom_reply);
-        g_free(prop_reply);
-        tmp_error =
-            g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "socket path property reply is null");
-        g_propagate_error(err, tmp_error);
-        return NULL;
+    if (g_queue_remove(lane->pending, entry)) {
+        /* nobody else saw it, so the error goes to the caller only */
+        ipc_pending_reply_resolve(entry, NULL, g_error_copy(tmp_error), &completed);
     }
 
-    socket_path = malloc(len + 1);
+    g_mutex_unlock(&self->priv->lock);
 
-    strncpy(socket_path, (char *)xcb_get_property_value(prop_reply), len);
-    socket_path[len] = '\0';
+    ipc_pending_reply_finish_all(&completed);
+    g_propagate_error(err, tmp_error);
 
-    g_free(atom_reply);
-    g_free(prop_reply);
-    xcb_disconnect(conn);
-
-    return socket_path;
+    return FALSE;
 }
 
 /*
- * Connects to the i3 IPC socket and returns the file descriptor for the
- * socket.
+ * Blocks until @entry has been answered and drops the reference of the
+ * caller. Replies to requests that were sent before it are handed to their
+ * callers on the way.
+ *
+ * Of all the threads that wait for a reply, one reads from the socket and the
+ * others sleep until it has handed out what it read. When the reply of the
+ * reader has come, another thread takes over. No lock is held while waiting
+ * for the socket.
+ *
+ * When @deadline passes or @cancellable is cancelled first, the entry is left
+ * in the queue as if it were a cancelled asynchronous request, so its reply is
+ * discarded when it arrives and the replies after it still line up.
  */
-static int get_file_descriptor(const char *socket_path, GError **err) {
+static gchar *ipc_wait_for_reply(i3ipcConnection *self, i3ipcLane *lane,
+                                 i3ipcPendingReply *entry, gsize *reply_length, gint64 deadline,
+                                 GCancellable *cancellable, GError **err) {
     GError *tmp_error = NULL;
+    gulong cancel_id = 0;
+    gchar *reply = NULL;
 
-    int sockfd = socket(AF_LOCAL, SOCK_STREAM, 0);
-
-    if (sockfd == -1) {
-        tmp_error = g_error_new(G_IO_ERROR, g_io_error_from_errno(errno),
-                                "Could not create socket (%s)\n", strerror(errno));
-        g_propagate_error(err, tmp_error);
-        return -1;
+    if (cancellable != NULL) {
+        cancel_id = g_cancellable_connect(cancellable, G_CALLBACK(ipc_on_wait_cancelled), self,
+                                          NULL);
     }
 
-    (void)fcntl(sockfd, F_SETFD, FD_CLOEXEC);
+    g_mutex_lock(&self->priv->lock);
 
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(struct sockaddr_un));
-    addr.sun_family = AF_LOCAL;
-    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    while (!entry->done && tmp_error == NULL) {
+        if (lane->reading) {
+            if (g_cancellable_set_error_if_cancelled(cancellable, &tmp_error)) {
+                break;
+            }
 
-    if (connect(sockfd, (const struct sockaddr *)&addr, sizeof(struct sockaddr_un)) < 0) {
-        tmp_error = g_error_new(G_IO_ERROR, g_io_error_from_errno(errno),
-                                "Could not connect to i3 (%s)\n", strerror(errno));
-        g_propagate_error(err, tmp_error);
-        return -1;
-    }
+            if (deadline < 0) {
+                g_cond_wait(&self->priv->reply_cond, &self->priv->lock);
+            } else if (!g_cond_wait_until(&self->priv->reply_cond, &self->priv->lock, deadline) &&
+                       !entry->done) {
+                g_set_error_literal(&tmp_error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                                    "Timed out waiting for the reply");
+            }
 
-    return sockfd;
-}
+            continue;
+        }
 
-/*
- * Blockingly receives a message from the ipc socket. Returns the status of the last read.
- */
-static GIOStatus ipc_recv_message(GIOChannel *channel, uint32_t *message_type,
-                                  uint32_t *reply_length, gchar **reply, GError **err) {
-    /* Read the message header first */
-    GError *tmp_error = NULL;
-    const uint32_t to_read = strlen(I3IPC_MAGIC) + sizeof(uint32_t) + sizeof(uint32_t);
-    char msg[to_read];
-    char *walk = msg;
-    GIOStatus status;
+        lane->reading = TRUE;
+        g_mutex_unlock(&self->priv->lock);
 
-    status = g_io_channel_flush(channel, &tmp_error);
+        if (deadline < 0 && cancellable == NULL) {
+            ipc_read_replies(self, lane, TRUE);
+        } else if (ipc_wait_fd(g_io_channel_unix_get_fd(lane->channel), G_IO_IN, deadline,
+                               cancellable, &tmp_error)) {
+            ipc_read_replies(self, lane, FALSE);
+        }
 
-    if (tmp_error != NULL) {
-        g_propagate_error(err, tmp_error);
-        return status;
+        g_mutex_lock(&self->priv->lock);
+        ipc_lane_release_reader(self, lane);
     }
 
-    gsize read_bytes = 0;
-    while (read_bytes < to_read) {
-        status = g_io_channel_read_chars(channel, msg + read_bytes, to_read - read_bytes,
-                                         &read_bytes, &tmp_error);
+    if (entry->done) {
+        g_clear_error(&tmp_error);
 
-        if (tmp_error != NULL) {
-            g_propagate_error(err, tmp_error);
-            return status;
-        }
+        tmp_error = entry->error;
+        entry->error = NULL;
+        reply = entry->reply;
+        entry->reply = NULL;
 
-        if (status == G_IO_STATUS_EOF) {
-            return status;
+        if (reply_length != NULL) {
+            *reply_length = entry->reply_length;
         }
+    } else {
+        entry->sync = FALSE;
     }
 
-    if (memcmp(walk, I3IPC_MAGIC, strlen(I3IPC_MAGIC)) != 0) {
-        /* TODO i3ipc custom errors */
-        tmp_error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "Invalid magic in reply");
-        g_propagate_error(err, tmp_error);
-        return status;
-    }
+    g_mutex_unlock(&self->priv->lock);
 
-    walk += strlen(I3IPC_MAGIC);
-    memcpy(reply_length, walk, sizeof(uint32_t));
-    walk += sizeof(uint32_t);
-    if (message_type != NULL) {
-        memcpy(message_type, walk, sizeof(uint32_t));
+    if (cancel_id != 0) {
+        g_cancellable_disconnect(cancellable, cancel_id);
     }
 
-    *reply = malloc(*reply_length + 1);
-
-    read_bytes = 0;
-    while (read_bytes < *reply_length) {
-        status = g_io_channel_read_chars(channel, *reply + read_bytes, *reply_length - read_bytes,
-                                         &read_bytes, &tmp_error);
+    ipc_pending_reply_unref(entry);
 
-        if (tmp_error != NULL) {
-            g_propagate_error(err, tmp_error);
-            return status;
-        }
-
-        if (status == G_IO_STATUS_EOF) {
-            return status;
-        }
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
     }
 
-    return status;
+    return reply;
 }
 
 /*
- * Callback function for when a channel receives data from the ipc socket.
- * Emits the corresponding signal with the reply.
+ * Sends a message synchronously and returns the reply along with its length.
+ * Gives up when @deadline passes or @cancellable is cancelled. High priority
+ * messages go over their own socket so they do not queue behind the others.
  */
-static gboolean ipc_on_data(GIOChannel *channel, GIOCondition condition, i3ipcConnection *conn) {
-    if (condition != G_IO_IN) {
-        return TRUE;
-    }
-
-    GIOStatus status;
-    uint32_t reply_length;
-    uint32_t reply_type;
+static gchar *ipc_message_sync_full(i3ipcConnection *self, i3ipcMessageType message_type,
+                                    const struct iovec *payload, gint n_payload,
+                                    i3ipcMessagePriority priority, gsize *reply_length,
+                                    gint64 deadline, GCancellable *cancellable, GError **err) {
+    GError *tmp_error = NULL;
+    i3ipcLane *lane = (priority == I3IPC_MESSAGE_PRIORITY_HIGH ? &self->priv->high_lane
+                                                               : &self->priv->cmd_lane);
+    i3ipcPendingReply *entry;
+    guint generation;
+    gboolean reconnected;
     gchar *reply;
-    GError *err = NULL;
-    JsonParser *parser;
-    JsonObject *json_reply;
-
-    status = ipc_recv_message(channel, &reply_type, &reply_length, &reply, &err);
 
-    if (status == G_IO_STATUS_EOF) {
-        g_signal_emit(conn, connection_signals[IPC_SHUTDOWN], 0);
-
-        if (conn->priv->main_loop != NULL) {
-            i3ipc_connection_main_quit(conn);
-        }
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
 
-        return FALSE;
+    if (!ipc_ensure_init(self, err)) {
+        return NULL;
     }
 
-    if (err) {
-        g_warning("could not get event reply\n");
-        g_error_free(err);
-        g_free(reply);
-        return TRUE;
+    generation = g_atomic_int_get(&self->priv->generation);
+
+    if (!self->priv->connected && ipc_can_reconnect_sync(self) &&
+        !ipc_reconnect_sync(self, generation, deadline, cancellable, err)) {
+        return NULL;
     }
 
-    reply[reply_length] = '\0';
+    if (message_type == I3IPC_MESSAGE_TYPE_SUBSCRIBE) {
+        /* the subscription socket has a single reader and is replaced by
+         * reconnecting, so subscriptions take turns with reconnects */
+        g_rec_mutex_lock(&self->priv->reconnect_lock);
 
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &err);
+        if (!ipc_open_events(self, err)) {
+            g_rec_mutex_unlock(&self->priv->reconnect_lock);
+            return NULL;
+        }
 
-    if (err) {
-        g_warning("could not parse event reply json (%s)\n", err->message);
-        g_error_free(err);
-        g_free(reply);
-        g_object_unref(parser);
-        return TRUE;
-    }
+        ipc_send_message_v(self, g_io_channel_unix_get_fd(self->priv->sub_channel), message_type,
+                           payload, n_payload, deadline, cancellable, &tmp_error);
 
-    json_reply = json_node_get_object(json_parser_get_root(parser));
+        if (tmp_error != NULL && ipc_error_is_disconnect(tmp_error) &&
+            ipc_can_reconnect_sync(self)) {
+            g_clear_error(&tmp_error);
 
-    switch (1 << (reply_type & 0x7F)) {
-    case I3IPC_EVENT_WORKSPACE: {
-        i3ipcWorkspaceEvent *e = g_slice_new0(i3ipcWorkspaceEvent);
+            /* the events context may need the lock to reconnect */
+            g_rec_mutex_unlock(&self->priv->reconnect_lock);
+            reconnected = ipc_reconnect_sync(self, generation, deadline, cancellable, &tmp_error);
+            g_rec_mutex_lock(&self->priv->reconnect_lock);
 
-        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+            if (reconnected && ipc_open_events(self, &tmp_error)) {
+                ipc_send_message_v(self, g_io_channel_unix_get_fd(self->priv->sub_channel),
+                                   message_type, payload, n_payload, deadline, cancellable,
+                                   &tmp_error);
+            }
+        }
 
-        if (json_object_has_member(json_reply, "current") &&
-            !json_object_get_null_member(json_reply, "current")) {
-            e->current =
-                i3ipc_con_new(NULL, json_object_get_object_member(json_reply, "current"), conn);
+        if (tmp_error != NULL) {
+            g_rec_mutex_unlock(&self->priv->reconnect_lock);
+            g_propagate_error(err, tmp_error);
+            return NULL;
         }
 
-        if (json_object_has_member(json_reply, "old") &&
-            !json_object_get_null_member(json_reply, "old")) {
-            e->old = i3ipc_con_new(NULL, json_object_get_object_member(json_reply, "old"), conn);
+        reply = ipc_wait_for_sub_reply(self, deadline, cancellable, err);
+        g_rec_mutex_unlock(&self->priv->reconnect_lock);
+
+        if (reply != NULL && reply_length != NULL) {
+            *reply_length = strlen(reply);
         }
 
-        g_signal_emit(conn, connection_signals[WORKSPACE], g_quark_from_string(e->change), e);
-        break;
+        return reply;
     }
 
-    case I3IPC_EVENT_OUTPUT: {
-        i3ipcGenericEvent *e = g_slice_new0(i3ipcGenericEvent);
+    entry = ipc_pending_reply_new(message_type, TRUE);
 
-        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+    if (!ipc_send_request(self, lane, entry, payload, n_payload, deadline, cancellable,
+                          &tmp_error) &&
+        ipc_error_is_disconnect(tmp_error) && ipc_can_reconnect_sync(self)) {
+        /* i3 never saw the message, so it is safe to send it again */
+        g_clear_error(&tmp_error);
+        ipc_pending_reply_unref(entry);
+        entry = ipc_pending_reply_new(message_type, TRUE);
 
-        g_signal_emit(conn, connection_signals[OUTPUT], g_quark_from_string(e->change), e);
-        break;
+        if (ipc_reconnect_sync(self, generation, deadline, cancellable, &tmp_error)) {
+            ipc_send_request(self, lane, entry, payload, n_payload, deadline, cancellable,
+                             &tmp_error);
+        }
     }
 
-    case I3IPC_EVENT_MODE: {
-        i3ipcGenericEvent *e = g_slice_new0(i3ipcGenericEvent);
+    if (tmp_error != NULL) {
+        ipc_pending_reply_unref(entry);
+        g_propagate_error(err, tmp_error);
+        return NULL;
+    }
 
-        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+    return ipc_wait_for_reply(self, lane, entry, reply_length, deadline, cancellable, err);
+}
 
-        g_signal_emit(conn, connection_signals[MODE], g_quark_from_string(e->change), e);
-        break;
-    }
+/*
+ * Sends a message synchronously with the timeout of the connection.
+ */
+static gchar *ipc_message_sync(i3ipcConnection *self, i3ipcMessageType message_type,
+                              const struct iovec *payload, gint n_payload, gsize *reply_length,
+                              GError **err) {
+    return ipc_message_sync_full(self, message_type, payload, n_payload,
+                                 I3IPC_MESSAGE_PRIORITY_NORMAL, reply_length,
+                                 ipc_deadline(self->priv->timeout), NULL, err);
+}
 
-    case I3IPC_EVENT_WINDOW: {
-        i3ipcWindowEvent *e = g_slice_new0(i3ipcWindowEvent);
+/**
+ * i3ipc_connection_message:
+ * @self: A #i3ipcConnection
+ * @message_type: The type of message to send to i3
+ * @payload: (allow-none): The body of the command
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Sends a command to the ipc synchronously.
+ *
+ * Returns: (transfer full): The reply of the ipc as a string
+ */
+gchar *i3ipc_connection_message(i3ipcConnection *self, i3ipcMessageType message_type,
+                                const gchar *payload, GError **err) {
+    const struct iovec iov = {.iov_base = (gpointer)payload,
+                              .iov_len = (payload != NULL ? strlen(payload) : 0)};
 
-        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+    return ipc_message_sync(self, message_type, &iov, 1, NULL, err);
+}
 
-        if (json_object_has_member(json_reply, "container") &&
-            !json_object_get_null_member(json_reply, "container"))
-            e->container =
-                i3ipc_con_new(NULL, json_object_get_object_member(json_reply, "container"), conn);
+/**
+ * i3ipc_connection_message_full:
+ * @self: A #i3ipcConnection
+ * @message_type: The type of message to send to i3
+ * @payload: (allow-none): The body of the command
+ * @priority: The #i3ipcMessagePriority of the message
+ * @timeout: How long to wait for the reply in milliseconds, or -1 to wait
+ * forever
+ * @cancellable: (allow-none): a #GCancellable or NULL
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Sends a command to the ipc synchronously, but gives up waiting for the
+ * reply after @timeout with %G_IO_ERROR_TIMED_OUT, or when @cancellable is
+ * cancelled with %G_IO_ERROR_CANCELLED. The connection stays usable either
+ * way: the reply is dropped when it arrives later. The same goes for sending
+ * the message while i3 does not read it, except that a message that only went
+ * out in part closes the socket.
+ *
+ * A message with %I3IPC_MESSAGE_PRIORITY_HIGH is sent on a second command
+ * socket, which is opened the first time it is needed. It does not wait for
+ * the replies to the messages that other threads have sent before it, so
+ * use it for the messages the user is waiting on.
+ *
+ * The #i3ipcConnection:timeout property sets a deadline for all the other
+ * synchronous calls.
+ *
+ * Returns: (transfer full): The reply of the ipc as a string
+ */
+gchar *i3ipc_connection_message_full(i3ipcConnection *self, i3ipcMessageType message_type,
+                                     const gchar *payload, i3ipcMessagePriority priority,
+                                     gint timeout, GCancellable *cancellable, GError **err) {
+    const struct iovec iov = {.iov_base = (gpointer)payload,
+                              .iov_len = (payload != NULL ? strlen(payload) : 0)};
+
+    return ipc_message_sync_full(self, message_type, &iov, 1, priority, NULL,
+                                 ipc_deadline(timeout), cancellable, err);
+}
 
-        g_signal_emit(conn, connection_signals[WINDOW], g_quark_from_string(e->change), e);
-        break;
-    }
+/**
+ * i3ipc_connection_message_v: (skip)
+ * @self: A #i3ipcConnection
+ * @message_type: The type of message to send to i3
+ * @payload: (array length=n_payload): The pieces of the body of the command
+ * @n_payload: The number of pieces in @payload
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Sends a command to the ipc synchronously. The body is the concatenation of
+ * the buffers in @payload, which are written to the socket directly without
+ * being copied.
+ *
+ * Returns: (transfer full): The reply of the ipc as a string
+ */
+gchar *i3ipc_connection_message_v(i3ipcConnection *self, i3ipcMessageType message_type,
+                                  const struct iovec *payload, gint n_payload, GError **err) {
+    g_return_val_if_fail(payload != NULL || n_payload == 0, NULL);
 
-    case I3IPC_EVENT_BARCONFIG_UPDATE: {
-        i3ipcBarconfigUpdateEvent *e = g_slice_new0(i3ipcBarconfigUpdateEvent);
+    return ipc_message_sync(self, message_type, payload, n_payload, NULL, err);
+}
 
-        e->id = g_strdup(json_object_get_string_member(json_reply, "id"));
-        e->hidden_state = g_strdup(json_object_get_string_member(json_reply, "hidden_state"));
-        e->mode = g_strdup(json_object_get_string_member(json_reply, "mode"));
+/**
+ * i3ipc_connection_message_bytes:
+ * @self: A #i3ipcConnection
+ * @message_type: The type of message to send to i3
+ * @payload: (allow-none): The body of the command
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Sends a command to the ipc synchronously. The body is written to the socket
+ * directly from @payload without being copied.
+ *
+ * Returns: (transfer full): The reply of the ipc as a string
+ */
+gchar *i3ipc_connection_message_bytes(i3ipcConnection *self, i3ipcMessageType message_type,
+                                      GBytes *payload, GError **err) {
+    struct iovec iov = {NULL, 0};
 
-        g_signal_emit(conn, connection_signals[BARCONFIG_UPDATE], 0, e);
-        break;
+    if (payload != NULL) {
+        iov.iov_base = (gpointer)g_bytes_get_data(payload, &iov.iov_len);
     }
-    case I3IPC_EVENT_BINDING: {
-        i3ipcBindingEvent *e = g_slice_new0(i3ipcBindingEvent);
 
-        e->change = g_strdup(json_object_get_string_member(json_reply, "change"));
+    return ipc_message_sync(self, message_type, &iov, 1, NULL, err);
+}
 
-        JsonObject *json_binding_info = json_object_get_object_member(json_reply, "binding");
-        e->binding = g_slice_new0(i3ipcBindingInfo);
-        e->binding->command = g_strdup(json_object_get_string_member(json_binding_info, "command"));
-        e->binding->input_code = json_object_get_int_member(json_binding_info, "input_code");
-        e->binding->input_type =
-            g_strdup(json_object_get_string_member(json_binding_info, "input_type"));
-        e->binding->symbol = g_strdup(json_object_get_string_member(json_binding_info, "symbol"));
+/**
+ * i3ipc_connection_message_raw:
+ * @self: A #i3ipcConnection
+ * @message_type: The type of message to send to i3
+ * @payload: (allow-none): The body of the command
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Sends a command to the ipc synchronously and returns the undecoded payload
+ * of the reply. The bytes are not copied again after they are taken out of
+ * the receive buffer.
+ *
+ * Returns: (transfer full): The reply of the ipc
+ */
+GBytes *i3ipc_connection_message_raw(i3ipcConnection *self, i3ipcMessageType message_type,
+                                     const gchar *payload, GError **err) {
+    const struct iovec iov = {.iov_base = (gpointer)payload,
+                              .iov_len = (payload != NULL ? strlen(payload) : 0)};
+    gchar *reply;
+    gsize reply_length = 0;
 
-        JsonArray *mods = json_object_get_array_member(json_binding_info, "mods");
-        gint mods_len = json_array_get_length(mods);
+    reply = ipc_message_sync(self, message_type, &iov, 1, &reply_length, err);
 
-        for (int i = 0; i < mods_len; i += 1) {
-            e->binding->mods =
-                g_slist_append(e->binding->mods, g_strdup(json_array_get_string_element(mods, i)));
-        }
+    if (reply == NULL) {
+        return NULL;
+    }
 
-        g_signal_emit(conn, connection_signals[BINDING], g_quark_from_string(e->change), e);
-        break;
+    return g_bytes_new_take(reply, reply_length);
+}
+
+/**
+ * i3ipc_connection_message_pipelined:
+ * @self: A #i3ipcConnection
+ * @message_types: (array length=n_messages): The types of the messages to send
+ * @payloads: (array length=n_messages) (allow-none): The bodies of the
+ * messages, or NULL if none of them has a body
+ * @n_messages: The number of messages
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Sends several messages to the ipc with a single write and then waits for
+ * all of their replies, so the whole batch costs about one round trip. The replies
+ * are matched to the messages in the order they were sent.
+ *
+ * The asynchronous variants of the query functions are pipelined the same way
+ * when they are called one after another.
+ *
+ * Returns: (transfer full) (element-type utf8): The replies of the ipc as
+ * strings, in the order of @message_types
+ */
+GPtrArray *i3ipc_connection_message_pipelined(i3ipcConnection *self,
+                                              const i3ipcMessageType *message_types,
+                                              const gchar *const *payloads, guint n_messages,
+                                              GError **err) {
+    GError *tmp_error = NULL;
+    GQueue completed = G_QUEUE_INIT;
+    GPtrArray *retval;
+    i3ipcPendingReply **entries;
+    i3_ipc_header_t *headers;
+    struct iovec *iov;
+    guint n_sent = 0;
+    i3ipcLane *lane;
+    gint64 deadline;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(self), NULL);
+    g_return_val_if_fail(message_types != NULL || n_messages == 0, NULL);
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+
+    lane = &self->priv->cmd_lane;
+    deadline = ipc_deadline(self->priv->timeout);
+
+    if (!ipc_ensure_init(self, err)) {
+        return NULL;
     }
 
-    default:
-        g_warning("got unknown event\n");
-        break;
+    for (guint i = 0; i < n_messages; i += 1) {
+        if (message_types[i] == I3IPC_MESSAGE_TYPE_SUBSCRIBE) {
+            g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                "Subscriptions must be made with i3ipc_connection_subscribe()");
+            return NULL;
+        }
     }
 
-    g_object_unref(parser);
-    g_free(reply);
+    headers = g_new(i3_ipc_header_t, n_messages);
+    iov = g_new(struct iovec, 2 * n_messages);
 
-    return TRUE;
-}
+    for (guint i = 0; i < n_messages; i += 1) {
+        const gchar *payload = (payloads != NULL && payloads[i] != NULL ? payloads[i] : "");
 
-static gboolean i3ipc_connection_initable_init(GInitable *initable, GCancellable *cancellable,
-                                               GError **err) {
-    i3ipcConnection *self = I3IPC_CONNECTION(initable);
-    GError *tmp_error = NULL;
+        iov[2 * i + 1].iov_base = (gpointer)payload;
+        iov[2 * i + 1].iov_len = strlen(payload);
+        iov[2 * i].iov_base = &headers[i];
+        iov[2 * i].iov_len = sizeof(i3_ipc_header_t);
 
-    g_return_val_if_fail(err == NULL || *err == NULL, FALSE);
+        if (!ipc_header_init(&headers[i], message_types[i], &iov[2 * i + 1], 1, err)) {
+            g_free(headers);
+            g_free(iov);
+            return NULL;
+        }
+    }
 
-    self->priv->socket_path = i3ipc_connection_get_socket_path(self, &tmp_error);
+    entries = g_new0(i3ipcPendingReply *, n_messages);
 
-    if (tmp_error != NULL) {
-        g_propagate_error(err, tmp_error);
-        return FALSE;
+    for (guint i = 0; i < n_messages; i += 1) {
+        entries[i] = ipc_pending_reply_new(message_types[i], TRUE);
     }
 
-    int cmd_fd = get_file_descriptor(self->priv->socket_path, &tmp_error);
+    /* the batch is not interleaved with the messages of other threads */
+    g_mutex_lock(&lane->send_lock);
 
-    if (tmp_error != NULL) {
-        g_propagate_error(err, tmp_error);
-        return FALSE;
+    if (lane->channel != NULL) {
+        g_mutex_lock(&self->priv->lock);
+
+        for (guint i = 0; i < n_messages; i += 1) {
+            g_queue_push_tail(lane->pending, ipc_pending_reply_ref(entries[i]));
+        }
+
+        g_mutex_unlock(&self->priv->lock);
+
+        /* the whole batch goes out with one syscall when the socket has room */
+        if (!ipc_send_iov(self, g_io_channel_unix_get_fd(lane->channel), iov, 2 * n_messages,
+                          deadline, NULL, &tmp_error)) {
+            /* the messages that went out completely keep waiting for their
+             * replies */
+            while (n_sent < n_messages && iov[2 * n_sent].iov_len == 0 &&
+                   iov[2 * n_sent + 1].iov_len == 0) {
+                n_sent += 1;
+            }
+
+            if (n_sent < n_messages && iov[2 * n_sent].iov_len < sizeof(i3_ipc_header_t)) {
+                /* a message that only went out in part leaves the stream out
+                 * of step, so the socket is shut down and the reader fails
+                 * everything that waits on it */
+                shutdown(g_io_channel_unix_get_fd(lane->channel), SHUT_RDWR);
+                n_sent += 1;
+            }
+        }
+    } else {
+        tmp_error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                                        "The ipc connection was closed");
     }
 
-    self->priv->cmd_channel = g_io_channel_unix_new(cmd_fd);
+    g_mutex_unlock(&lane->send_lock);
 
-    int sub_fd = get_file_descriptor(self->priv->socket_path, &tmp_error);
+    g_free(headers);
+    g_free(iov);
 
     if (tmp_error != NULL) {
-        g_propagate_error(err, tmp_error);
-        return FALSE;
+        /* only the messages of this call that never went out fail here, the
+         * requests of other threads are left alone */
+        g_mutex_lock(&self->priv->lock);
+
+        for (guint i = n_sent; i < n_messages; i += 1) {
+            if (g_queue_remove(lane->pending, entries[i])) {
+                ipc_pending_reply_resolve(entries[i], NULL, g_error_copy(tmp_error),
+                                          &completed);
+            } else if (!entries[i]->done) {
+                /* never queued, so nothing fails it */
+                entries[i]->done = TRUE;
+                entries[i]->error = g_error_copy(tmp_error);
+            }
+        }
+
+        g_mutex_unlock(&self->priv->lock);
+
+        ipc_pending_reply_finish_all(&completed);
+        g_clear_error(&tmp_error);
     }
 
-    self->priv->sub_channel = g_io_channel_unix_new(sub_fd);
+    retval = g_ptr_array_new_with_free_func(g_free);
 
-    g_io_channel_set_encoding(self->priv->cmd_channel, NULL, &tmp_error);
+    for (guint i = 0; i < n_messages; i += 1) {
+        gchar *reply = ipc_wait_for_reply(self, lane, entries[i], NULL, deadline, NULL,
+                                          (tmp_error == NULL ? &tmp_error : NULL));
 
-    if (tmp_error != NULL) {
-        g_propagate_error(err, tmp_error);
-        return FALSE;
+        g_ptr_array_add(retval, reply);
     }
 
-    g_io_channel_set_encoding(self->priv->sub_channel, NULL, &tmp_error);
+    g_free(entries);
 
     if (tmp_error != NULL) {
+        g_ptr_array_unref(retval);
         g_propagate_error(err, tmp_error);
-        return FALSE;
+        return NULL;
     }
 
-    g_io_add_watch(self->priv->sub_channel, G_IO_IN, (GIOFunc)ipc_on_data, self);
-
-    self->priv->connected = TRUE;
-
-    return TRUE;
-}
-
-static void i3ipc_connection_initable_iface_init(GInitableIface *iface) {
-    iface->init = i3ipc_connection_initable_init;
+    return retval;
 }
 
-/*
- * Sends a message to the ipc.
+/**
+ * i3ipc_connection_message_async:
+ * @self: A #i3ipcConnection
+ * @message_type: The type of message to send to i3
+ * @payload: (allow-none): The body of the command
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Sends a command to the ipc asynchronously. The reply is read from the
+ * thread-default main context of the caller when it arrives, so the caller
+ * never blocks on the socket. Call i3ipc_connection_message_finish() from
+ * @callback to get the reply.
+ *
+ * Subscriptions have to go through i3ipc_connection_subscribe().
  */
-static GIOStatus ipc_send_message(GIOChannel *channel, const uint32_t message_size,
-                                  const uint32_t message_type, const gchar *command, GError **err) {
+void i3ipc_connection_message_async(i3ipcConnection *self, i3ipcMessageType message_type,
+                                    const gchar *payload, GCancellable *cancellable,
+                                    GAsyncReadyCallback callback, gpointer user_data) {
     GError *tmp_error = NULL;
-    GIOStatus status;
-    gsize sent_bytes;
+    struct iovec iov;
+    GTask *task;
+    i3ipcPendingReply *entry;
 
-    const i3_ipc_header_t header = {
-        .magic = {'i', '3', '-', 'i', 'p', 'c'}, .size = message_size, .type = message_type};
+    g_return_if_fail(I3IPC_IS_CONNECTION(self));
 
-    sent_bytes = 0;
+    task = g_task_new(self, cancellable, callback, user_data);
+    g_task_set_source_tag(task, i3ipc_connection_message_async);
 
-    while (sent_bytes < sizeof(i3_ipc_header_t)) {
-        status =
-            g_io_channel_write_chars(channel, ((void *)&header) + sent_bytes,
-                                     sizeof(i3_ipc_header_t) - sent_bytes, &sent_bytes, &tmp_error);
+    if (!ipc_ensure_init(self, &tmp_error)) {
+        g_task_return_error(task, tmp_error);
+        g_object_unref(task);
+        return;
+    }
 
-        if (tmp_error != NULL) {
-            g_propagate_error(err, tmp_error);
-            return status;
-        }
+    if (message_type == I3IPC_MESSAGE_TYPE_SUBSCRIBE) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                "Subscriptions must be made with i3ipc_connection_subscribe()");
+        g_object_unref(task);
+        return;
+    }
+
+    if (payload == NULL) {
+        payload = "";
     }
 
-    sent_bytes = 0;
+    iov.iov_base = (gpointer)payload;
+    iov.iov_len = strlen(payload);
 
-    while (sent_bytes < message_size) {
-        status = g_io_channel_write_chars(channel, command + sent_bytes, message_size - sent_bytes,
-                                          &sent_bytes, &tmp_error);
+    entry = ipc_pending_reply_new(message_type, FALSE);
+    entry->task = task;
 
-        if (tmp_error != NULL) {
-            g_propagate_error(err, tmp_error);
-            return status;
+    if (cancellable != NULL) {
+        entry->cancel_source = g_cancellable_source_new(cancellable);
+        g_source_set_callback(entry->cancel_source, (GSourceFunc)ipc_on_request_cancelled,
+                              ipc_pending_reply_ref(entry), ipc_pending_reply_unref);
+        g_source_attach(entry->cancel_source, g_task_get_context(task));
+    }
+
+    /* on failure the error has been returned to the task already */
+    if (ipc_send_request(self, &self->priv->cmd_lane, entry, &iov, 1, -1, cancellable, NULL)) {
+        g_mutex_lock(&self->priv->lock);
+
+        if (!entry->done) {
+            ipc_watch_replies(self, g_task_get_context(task));
         }
+
+        g_mutex_unlock(&self->priv->lock);
     }
 
-    return status;
+    ipc_pending_reply_unref(entry);
 }
 
 /**
- * i3ipc_connection_message:
+ * i3ipc_connection_message_finish:
  * @self: A #i3ipcConnection
- * @message_type: The type of message to send to i3
- * @payload: (allow-none): The body of the command
+ * @result: the #GAsyncResult passed to the callback
  * @err: (allow-none): return location for a GError, or NULL
  *
- * Sends a command to the ipc synchronously.
+ * Finishes an operation started with i3ipc_connection_message_async().
  *
  * Returns: (transfer full): The reply of the ipc as a string
  */
-gchar *i3ipc_connection_message(i3ipcConnection *self, i3ipcMessageType message_type,
-                                const gchar *payload, GError **err) {
-    GError *tmp_error = NULL;
-    GIOStatus status;
-    uint32_t reply_length;
-    uint32_t reply_type;
-    gchar *reply = NULL;
+gchar *i3ipc_connection_message_finish(i3ipcConnection *self, GAsyncResult *result,
+                                       GError **err) {
+    g_return_val_if_fail(g_task_is_valid(result, self), NULL);
+    g_return_val_if_fail(
+        g_task_get_source_tag(G_TASK(result)) == i3ipc_connection_message_async, NULL);
 
-    if (self->priv->init_error != NULL) {
-        g_propagate_error(err, self->priv->init_error);
-        return NULL;
+    return g_task_propagate_pointer(G_TASK(result), err);
+}
+
+/*
+ * Turns the JSON of a reply into the value returned to the caller.
+ */
+typedef gpointer (*i3ipcReplyParseFunc)(i3ipcConnection *self, JsonNode *root);
+
+/*
+ * How to parse the reply of a query. Replies without a parse function are
+ * returned as the raw string.
+ */
+typedef struct {
+    i3ipcReplyParseFunc parse;
+    GDestroyNotify free_func;
+} i3ipcReplyParser;
+
+/*
+ * Gets a parser for a reply. The one of the connection is reused unless
+ * another thread is parsing with it, then a new one is made.
+ */
+static JsonParser *ipc_reply_parser_acquire(i3ipcConnection *self) {
+    if (g_mutex_trylock(&self->priv->parser_lock)) {
+        return g_object_ref(self->priv->reply_parser);
     }
 
-    g_return_val_if_fail(!self->priv->connected || err == NULL || *err == NULL, NULL);
+    return json_parser_new();
+}
 
-    if (payload == NULL) {
-        payload = "";
+static void ipc_reply_parser_release(i3ipcConnection *self, JsonParser *json_parser) {
+    if (json_parser == self->priv->reply_parser) {
+        g_mutex_unlock(&self->priv->parser_lock);
     }
 
-    GIOChannel *channel = (message_type == I3IPC_MESSAGE_TYPE_SUBSCRIBE ? self->priv->sub_channel
-                                                                        : self->priv->cmd_channel);
+    g_object_unref(json_parser);
+}
+
+static gpointer ipc_parse_reply(i3ipcConnection *self, const gchar *reply,
+                                const i3ipcReplyParser *parser, GError **err) {
+    JsonParser *json_parser = ipc_reply_parser_acquire(self);
+    GError *tmp_error = NULL;
+    gpointer retval = NULL;
 
-    ipc_send_message(channel, strlen(payload), message_type, payload, &tmp_error);
+    json_parser_load_from_data(json_parser, reply, -1, &tmp_error);
 
     if (tmp_error != NULL) {
         g_propagate_error(err, tmp_error);
-        return NULL;
+    } else {
+        retval = parser->parse(self, json_parser_get_root(json_parser));
     }
 
-    status = ipc_recv_message(channel, &reply_type, &reply_length, &reply, &tmp_error);
+    ipc_reply_parser_release(self, json_parser);
+
+    return retval;
+}
+
+/*
+ * Sends a query synchronously with the given priority and parses the reply.
+ */
+static gpointer i3ipc_connection_query_full(i3ipcConnection *self, i3ipcMessageType message_type,
+                                            const gchar *payload, const i3ipcReplyParser *parser,
+                                            i3ipcMessagePriority priority, GError **err) {
+    const struct iovec iov = {.iov_base = (gpointer)payload,
+                              .iov_len = (payload != NULL ? strlen(payload) : 0)};
+    GError *tmp_error = NULL;
+    gpointer retval;
+    gchar *reply;
+
+    reply = ipc_message_sync_full(self, message_type, &iov, 1, priority, NULL,
+                                  ipc_deadline(self->priv->timeout), NULL, &tmp_error);
 
     if (tmp_error != NULL) {
+        g_free(reply);
         g_propagate_error(err, tmp_error);
         return NULL;
     }
 
-    if (status == G_IO_STATUS_NORMAL) {
-        reply[reply_length] = '\0';
+    if (parser->parse == NULL) {
+        return reply;
     }
 
-    return reply;
+    retval = ipc_parse_reply(self, reply, parser, err);
+    g_free(reply);
+
+    return retval;
 }
 
-/**
- * i3ipc_connection_command:
- * @self: A #i3ipcConnection
- * @command: The command to send to i3
- * @err: (allow-none): return location of a GError, or NULL
- *
- * Sends a command to the ipc synchronously.
- *
- * Returns: (transfer full) (element-type i3ipcCommandReply): a list of #i3ipcCommandReply structs
- * for each command that was parsed
+/*
+ * Sends a query synchronously and parses the reply.
  */
-GSList *i3ipc_connection_command(i3ipcConnection *self, const gchar *command, GError **err) {
-    JsonParser *parser;
-    GError *tmp_error = NULL;
-    GSList *retval = NULL;
+static gpointer i3ipc_connection_query(i3ipcConnection *self, i3ipcMessageType message_type,
+                                       const gchar *payload, const i3ipcReplyParser *parser,
+                                       GError **err) {
+    return i3ipc_connection_query_full(self, message_type, payload, parser,
+                                       I3IPC_MESSAGE_PRIORITY_NORMAL, err);
+}
 
-    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+static void ipc_on_query_reply(GObject *source, GAsyncResult *result, gpointer user_data) {
+    i3ipcConnection *self = I3IPC_CONNECTION(source);
+    GTask *task = user_data;
+    const i3ipcReplyParser *parser = g_task_get_task_data(task);
+    GError *tmp_error = NULL;
+    gpointer retval;
+    gchar *reply;
 
-    gchar *reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_COMMAND, command, &tmp_error);
+    reply = i3ipc_connection_message_finish(self, result, &tmp_error);
 
     if (tmp_error != NULL) {
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
+        g_task_return_error(task, tmp_error);
+        g_object_unref(task);
+        return;
     }
 
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &tmp_error);
+    if (parser->parse == NULL) {
+        g_task_return_pointer(task, reply, g_free);
+        g_object_unref(task);
+        return;
+    }
+
+    retval = ipc_parse_reply(self, reply, parser, &tmp_error);
+    g_free(reply);
 
     if (tmp_error != NULL) {
-        g_object_unref(parser);
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
+        g_task_return_error(task, tmp_error);
+    } else {
+        g_task_return_pointer(task, retval, parser->free_func);
     }
 
-    JsonArray *json_replies = json_node_get_array(json_parser_get_root(parser));
+    g_object_unref(task);
+}
+
+/*
+ * Sends a query asynchronously. The reply is parsed before @callback is
+ * called.
+ */
+static void i3ipc_connection_query_async(i3ipcConnection *self, i3ipcMessageType message_type,
+                                         const gchar *payload, const i3ipcReplyParser *parser,
+                                         gpointer source_tag, GCancellable *cancellable,
+                                         GAsyncReadyCallback callback, gpointer user_data) {
+    GTask *task;
+
+    g_return_if_fail(I3IPC_IS_CONNECTION(self));
+
+    task = g_task_new(self, cancellable, callback, user_data);
+    g_task_set_source_tag(task, source_tag);
+    g_task_set_task_data(task, (gpointer)parser, NULL);
+
+    i3ipc_connection_message_async(self, message_type, payload, cancellable, ipc_on_query_reply,
+                                   task);
+}
+
+static gpointer i3ipc_connection_query_finish(i3ipcConnection *self, GAsyncResult *result,
+                                              gpointer source_tag, GError **err) {
+    g_return_val_if_fail(g_task_is_valid(result, self), NULL);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) == source_tag, NULL);
+
+    return g_task_propagate_pointer(G_TASK(result), err);
+}
+
+static void ipc_command_reply_list_free(gpointer list) {
+    g_slist_free_full(list, (GDestroyNotify)i3ipc_command_reply_free);
+}
+
+static void ipc_workspace_reply_list_free(gpointer list) {
+    g_slist_free_full(list, (GDestroyNotify)i3ipc_workspace_reply_free);
+}
+
+static void ipc_output_reply_list_free(gpointer list) {
+    g_slist_free_full(list, (GDestroyNotify)i3ipc_output_reply_free);
+}
+
+static void ipc_string_list_free(gpointer list) {
+    g_slist_free_full(list, g_free);
+}
+
+static gpointer ipc_parse_command_reply(i3ipcConnection *self, JsonNode *root) {
+    GSList *retval = NULL;
+    JsonArray *json_replies = json_node_get_array(root);
 
     guint reply_count = json_array_get_length(json_replies);
 
@@ -869,12 +4257,85 @@ GSList *i3ipc_connection_command(i3ipcConnection *self, const gchar *command, GE
         retval = g_slist_append(retval, cmd_reply);
     }
 
-    g_object_unref(parser);
-    g_free(reply);
-
     return retval;
 }
 
+static const i3ipcReplyParser command_reply_parser = {ipc_parse_command_reply,
+                                                      ipc_command_reply_list_free};
+
+/**
+ * i3ipc_connection_command:
+ * @self: A #i3ipcConnection
+ * @command: The command to send to i3
+ * @err: (allow-none): return location of a GError, or NULL
+ *
+ * Sends a command to the ipc synchronously.
+ *
+ * Returns: (transfer full) (element-type i3ipcCommandReply): a list of #i3ipcCommandReply structs
+ * for each command that was parsed
+ */
+GSList *i3ipc_connection_command(i3ipcConnection *self, const gchar *command, GError **err) {
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_COMMAND, command, &command_reply_parser,
+                                  err);
+}
+
+/**
+ * i3ipc_connection_command_full:
+ * @self: A #i3ipcConnection
+ * @command: The command to send to i3
+ * @priority: The #i3ipcMessagePriority of the command
+ * @err: (allow-none): return location of a GError, or NULL
+ *
+ * Sends a command to the ipc synchronously with the given priority. See
+ * i3ipc_connection_message_full().
+ *
+ * Returns: (transfer full) (element-type i3ipcCommandReply): a list of #i3ipcCommandReply structs
+ * for each command that was parsed
+ */
+GSList *i3ipc_connection_command_full(i3ipcConnection *self, const gchar *command,
+                                      i3ipcMessagePriority priority, GError **err) {
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+
+    return i3ipc_connection_query_full(self, I3IPC_MESSAGE_TYPE_COMMAND, command,
+                                       &command_reply_parser, priority, err);
+}
+
+/**
+ * i3ipc_connection_command_async:
+ * @self: A #i3ipcConnection
+ * @command: The command to send to i3
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Sends a command to the ipc asynchronously. Call
+ * i3ipc_connection_command_finish() from @callback to get the result.
+ */
+void i3ipc_connection_command_async(i3ipcConnection *self, const gchar *command,
+                                    GCancellable *cancellable, GAsyncReadyCallback callback,
+                                    gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_COMMAND, command, &command_reply_parser,
+                                 i3ipc_connection_command_async, cancellable, callback, user_data);
+}
+
+/**
+ * i3ipc_connection_command_finish:
+ * @self: A #i3ipcConnection
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location of a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_command_async().
+ *
+ * Returns: (transfer full) (element-type i3ipcCommandReply): a list of #i3ipcCommandReply structs
+ * for each command that was parsed
+ */
+GSList *i3ipc_connection_command_finish(i3ipcConnection *self, GAsyncResult *result,
+                                        GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_command_async, err);
+}
+
 /**
  * i3ipc_connection_subscribe:
  * @self: A #i3ipcConnection
@@ -895,8 +4356,12 @@ i3ipcCommandReply *i3ipc_connection_subscribe(i3ipcConnection *self, i3ipcEvent
     gchar *payload;
     GError *tmp_error = NULL;
     i3ipcCommandReply *retval;
+    i3ipcEvent added;
+
+    /* one snapshot, since other threads subscribe and narrow concurrently */
+    added = events & ~ipc_get_subscriptions(self);
 
-    if (!(events & ~self->priv->subscriptions)) {
+    if (!added) {
         /* No new events */
         retval = g_slice_new0(i3ipcCommandReply);
         retval->success = TRUE;
@@ -906,27 +4371,27 @@ i3ipcCommandReply *i3ipc_connection_subscribe(i3ipcConnection *self, i3ipcEvent
     builder = json_builder_new();
     json_builder_begin_array(builder);
 
-    if (events & (I3IPC_EVENT_WINDOW & ~self->priv->subscriptions)) {
+    if (added & I3IPC_EVENT_WINDOW) {
         json_builder_add_string_value(builder, "window");
     }
 
-    if (events & (I3IPC_EVENT_BARCONFIG_UPDATE & ~self->priv->subscriptions)) {
+    if (added & I3IPC_EVENT_BARCONFIG_UPDATE) {
         json_builder_add_string_value(builder, "barconfig_update");
     }
 
-    if (events & (I3IPC_EVENT_MODE & ~self->priv->subscriptions)) {
+    if (added & I3IPC_EVENT_MODE) {
         json_builder_add_string_value(builder, "mode");
     }
 
-    if (events & (I3IPC_EVENT_OUTPUT & ~self->priv->subscriptions)) {
+    if (added & I3IPC_EVENT_OUTPUT) {
         json_builder_add_string_value(builder, "output");
     }
 
-    if (events & (I3IPC_EVENT_WORKSPACE & ~self->priv->subscriptions)) {
+    if (added & I3IPC_EVENT_WORKSPACE) {
         json_builder_add_string_value(builder, "workspace");
     }
 
-    if (events & (I3IPC_EVENT_BINDING & ~self->priv->subscriptions)) {
+    if (added & I3IPC_EVENT_BINDING) {
         json_builder_add_string_value(builder, "binding");
     }
 
@@ -949,15 +4414,15 @@ i3ipcCommandReply *i3ipc_connection_subscribe(i3ipcConnection *self, i3ipcEvent
         return NULL;
     }
 
-    parser = json_parser_new();
+    parser = ipc_reply_parser_acquire(self);
     json_parser_load_from_data(parser, reply, -1, &tmp_error);
 
     if (tmp_error != NULL) {
+        ipc_reply_parser_release(self, parser);
         g_free(reply);
         g_free(payload);
         g_object_unref(generator);
         g_object_unref(builder);
-        g_object_unref(parser);
         g_propagate_error(err, tmp_error);
         return NULL;
     }
@@ -967,19 +4432,156 @@ i3ipcCommandReply *i3ipc_connection_subscribe(i3ipcConnection *self, i3ipcEvent
     retval = g_slice_new0(i3ipcCommandReply);
     retval->success = json_object_get_boolean_member(json_reply, "success");
 
+    ipc_reply_parser_release(self, parser);
     g_free(reply);
     g_free(payload);
     g_object_unref(builder);
     g_object_unref(generator);
-    g_object_unref(parser);
 
     if (retval->success) {
-        self->priv->subscriptions |= events;
+        g_mutex_lock(&self->priv->lock);
+        self->priv->subscriptions |= added;
+        g_mutex_unlock(&self->priv->lock);
     }
 
     return retval;
 }
 
+/*
+ * A handler added with i3ipc_connection_on() for one type of event.
+ */
+typedef struct {
+    i3ipcConnection *conn;
+    guint type;
+} i3ipcEventHandler;
+
+/*
+ * Sends the subscriptions again on a new subscription socket, since the ipc
+ * cannot take back a subscription. Events that happen while the socket is
+ * replaced are lost, like during a reconnect. A connection that is detached
+ * keeps its socket, which is watched by someone else.
+ */
+static gboolean ipc_narrow_subscriptions(i3ipcConnection *self, i3ipcEvent subscriptions,
+                                         GError **err) {
+    GError *tmp_error = NULL;
+    i3ipcCommandReply *reply = NULL;
+
+    if (self->priv->events_detached || !self->priv->connected) {
+        return TRUE;
+    }
+
+    g_debug("narrowing the subscriptions from 0x%x to 0x%x", ipc_get_subscriptions(self),
+            subscriptions);
+
+    g_rec_mutex_lock(&self->priv->reconnect_lock);
+
+    ipc_close_events(self);
+    ipc_set_subscriptions(self, 0);
+
+    if (ipc_open_events(self, &tmp_error) && subscriptions != 0) {
+        reply = i3ipc_connection_subscribe(self, subscriptions, &tmp_error);
+
+        if (reply != NULL && !reply->success) {
+            tmp_error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                            "The subscriptions could not be restored");
+        }
+
+        i3ipc_command_reply_free(reply);
+    }
+
+    if (tmp_error != NULL) {
+        /* keep them so a reconnect sends them again */
+        ipc_set_subscriptions(self, subscriptions);
+    }
+
+    g_rec_mutex_unlock(&self->priv->reconnect_lock);
+
+    g_object_notify_by_pspec(G_OBJECT(self), obj_properties[PROP_SUBSCRIPTIONS]);
+
+    if (tmp_error != NULL) {
+        g_propagate_error(err, tmp_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Drops the subscriptions to the types of events that lost their last
+ * handler, unless a handler was connected to them some other way.
+ */
+static gboolean ipc_on_narrow_idle(gpointer user_data) {
+    i3ipcConnection *self = user_data;
+    i3ipcEvent dropped = 0;
+    i3ipcEvent subscribed;
+    GError *err = NULL;
+
+    g_mutex_lock(&self->priv->lock);
+
+    for (guint type = 0; type < I3IPC_N_EVENT_TYPES; type += 1) {
+        if ((self->priv->narrowable & (1 << type)) && self->priv->event_handlers[type] == 0) {
+            dropped |= (1 << type);
+        }
+    }
+
+    self->priv->narrowable = 0;
+    g_clear_pointer(&self->priv->narrow_source, g_source_unref);
+
+    g_mutex_unlock(&self->priv->lock);
+
+    /* a batch handler gets every type of event */
+    if (g_signal_has_handler_pending(self, connection_signals[EVENTS], 0, FALSE)) {
+        dropped = 0;
+    }
+
+    for (guint type = 0; type < I3IPC_N_EVENT_TYPES; type += 1) {
+        if ((dropped & (1 << type)) &&
+            g_signal_handler_find(self, G_SIGNAL_MATCH_ID, connection_signals[type], 0, NULL,
+                                  NULL, NULL) != 0) {
+            dropped &= ~(1 << type);
+        }
+    }
+
+    subscribed = ipc_get_subscriptions(self);
+
+    if ((dropped & subscribed) != 0 &&
+        !ipc_narrow_subscriptions(self, subscribed & ~dropped, &err)) {
+        g_warning("could not narrow the subscriptions (%s)\n", err->message);
+        g_error_free(err);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Called when a handler added with i3ipc_connection_on() is disconnected. The
+ * subscriptions are narrowed from the events context, since this may run in
+ * any thread.
+ */
+static void ipc_on_handler_invalidated(gpointer data, GClosure *closure) {
+    i3ipcEventHandler *handler = data;
+    i3ipcConnectionPrivate *priv = handler->conn->priv;
+
+    g_mutex_lock(&priv->lock);
+
+    priv->event_handlers[handler->type] -= 1;
+
+    if (priv->event_handlers[handler->type] == 0 && priv->events_context != NULL) {
+        priv->narrowable |= (1 << handler->type);
+
+        if (priv->narrow_source == NULL) {
+            priv->narrow_source = g_idle_source_new();
+            g_source_set_callback(priv->narrow_source, ipc_on_narrow_idle, handler->conn, NULL);
+            g_source_set_name(priv->narrow_source, "i3ipc narrow subscriptions");
+            g_source_attach(priv->narrow_source, priv->events_context);
+        }
+    }
+
+    g_mutex_unlock(&priv->lock);
+
+    g_slice_free(i3ipcEventHandler, handler);
+}
+
 /**
  * i3ipc_connection_on:
  * @self: an #i3ipcConnection
@@ -989,6 +4591,10 @@ i3ipcCommandReply *i3ipc_connection_subscribe(i3ipcConnection *self, i3ipcEvent
  *
  * A convenience function for bindings to subscribe an event with a callback
  *
+ * The connection keeps count of these handlers. Once the last one for a type
+ * of event is disconnected and no other handler is connected to its signal,
+ * the subscription to it is dropped so the ipc stops sending those events.
+ *
  * Returns: (transfer none): the #i3ipcConnection for chaining
  */
 i3ipcConnection *i3ipc_connection_on(i3ipcConnection *self, const gchar *event, GClosure *callback,
@@ -1019,60 +4625,184 @@ i3ipcConnection *i3ipc_connection_on(i3ipcConnection *self, const gchar *event,
         flags = I3IPC_EVENT_BINDING;
     }
 
-    if (flags) {
-        cmd_reply = i3ipc_connection_subscribe(self, flags, &tmp_error);
-        i3ipc_command_reply_free(cmd_reply);
+    if (flags) {
+        cmd_reply = i3ipc_connection_subscribe(self, flags, &tmp_error);
+        i3ipc_command_reply_free(cmd_reply);
+    } else {
+        /* signals like ipc_shutdown still need the socket to notice the loss */
+        if (ipc_ensure_init(self, &tmp_error)) {
+            ipc_open_events(self, &tmp_error);
+        }
+    }
+
+    if (tmp_error != NULL) {
+        g_strfreev(event_details);
+        g_closure_unref(callback);
+        g_propagate_error(err, tmp_error);
+        return NULL;
+    }
+
+    g_signal_connect_closure(self, event, callback, TRUE);
+
+    if (flags) {
+        i3ipcEventHandler *handler = g_slice_new(i3ipcEventHandler);
+
+        handler->conn = self;
+        handler->type = g_bit_nth_lsf(flags, -1);
+
+        g_mutex_lock(&self->priv->lock);
+        self->priv->event_handlers[handler->type] += 1;
+        g_mutex_unlock(&self->priv->lock);
+
+        g_closure_add_invalidate_notifier(callback, handler, ipc_on_handler_invalidated);
+    }
+
+    /* the handler holds the closure now, so disconnecting it invalidates the
+     * closure */
+    g_closure_unref(callback);
+    g_strfreev(event_details);
+
+    return self;
+}
+
+/**
+ * i3ipc_connection_get_event_handlers:
+ * @self: an #i3ipcConnection
+ * @events: the types of events to count the handlers of
+ *
+ * Counts the handlers that were added with i3ipc_connection_on() for any of
+ * @events and are still connected. A type of event whose count dropped to
+ * zero is no longer subscribed to.
+ *
+ * Returns: the number of handlers
+ */
+guint i3ipc_connection_get_event_handlers(i3ipcConnection *self, i3ipcEvent events) {
+    guint count = 0;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(self), 0);
 
-        if (tmp_error != NULL) {
-            g_strfreev(event_details);
-            g_propagate_error(err, tmp_error);
-            return NULL;
+    g_mutex_lock(&self->priv->lock);
+
+    for (guint type = 0; type < I3IPC_N_EVENT_TYPES; type += 1) {
+        if (events & (1 << type)) {
+            count += self->priv->event_handlers[type];
         }
     }
 
-    g_signal_connect_closure(self, event, callback, TRUE);
-
-    g_strfreev(event_details);
+    g_mutex_unlock(&self->priv->lock);
 
-    return self;
+    return count;
 }
 
 /**
- * i3ipc_connection_get_workspaces:
- * @self: An #i3ipcConnection
- * @err: (allow-none): return location of a GError, or NULL
+ * i3ipc_connection_set_coalesce:
+ * @self: an #i3ipcConnection
+ * @event: a single type of event
+ * @change: (allow-none): the change of the events, such as "title", or NULL
+ * for all the changes that have no policy of their own
+ * @interval: how long to hold the events back in milliseconds, or 0 to
+ * deliver them right away again
  *
- * Gets the current workspaces. The reply will be list workspaces
+ * Coalesces bursts of events, such as the "title" window events of a terminal
+ * that updates its title on every keystroke. The first matching event is held
+ * back for @interval, and the events for the same con that come in meanwhile
+ * replace it, so only the latest one is delivered. Events of other cons are
+ * held back side by side, and the held events are delivered in the order the
+ * ones that were kept came in. Events that are not held back are emitted right
+ * away, so they may come before events that came in earlier and were held
+ * back.
  *
- * Returns: (transfer full) (element-type i3ipcWorkspaceReply): a list of workspaces
+ * The events that are held back when a policy is removed are delivered on the
+ * events context.
  */
-GSList *i3ipc_connection_get_workspaces(i3ipcConnection *self, GError **err) {
-    JsonParser *parser;
-    JsonReader *reader;
-    gchar *reply;
-    GError *tmp_error = NULL;
-    GSList *retval = NULL;
+void i3ipc_connection_set_coalesce(i3ipcConnection *self, i3ipcEvent event, const gchar *change,
+                                   guint interval) {
+    i3ipcCoalescePolicy *policy;
+    i3ipcCoalesceFlush *flush = NULL;
+    guint signal;
+    GQuark detail = (change != NULL ? g_quark_from_string(change) : 0);
 
-    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+    g_return_if_fail(I3IPC_IS_CONNECTION(self));
+    g_return_if_fail(event != 0 && (event & (event - 1)) == 0);
 
-    reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_GET_WORKSPACES, "", &tmp_error);
+    signal = g_bit_nth_lsf(event, -1);
 
-    if (tmp_error != NULL) {
-        g_propagate_error(err, tmp_error);
-        return NULL;
+    g_mutex_lock(&self->priv->lock);
+
+    policy = ipc_coalesce_policy_find(self, signal, detail);
+
+    if (policy != NULL && interval == 0) {
+        if (policy->pending.length > 0) {
+            flush = g_slice_new(i3ipcCoalesceFlush);
+            flush->conn = g_object_ref(self);
+            flush->signal = signal;
+            flush->pending = policy->pending;
+            g_queue_init(&policy->pending);
+        }
+
+        /* this frees the policy and destroys its timeout */
+        g_ptr_array_remove_fast(self->priv->coalesce_policies, policy);
+    } else if (policy != NULL) {
+        policy->interval = interval;
+    } else if (interval != 0) {
+        policy = g_slice_new0(i3ipcCoalescePolicy);
+        policy->signal = signal;
+        policy->detail = detail;
+        policy->interval = interval;
+        g_queue_init(&policy->pending);
+
+        g_ptr_array_add(self->priv->coalesce_policies, policy);
     }
 
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &tmp_error);
+    g_mutex_unlock(&self->priv->lock);
 
-    if (tmp_error != NULL) {
-        g_object_unref(parser);
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
+    if (flush != NULL) {
+        g_main_context_invoke_full(self->priv->events_context, G_PRIORITY_DEFAULT,
+                                   ipc_on_coalesce_flush, flush, ipc_coalesce_flush_free);
+    }
+}
+
+/**
+ * i3ipc_connection_get_coalesced:
+ * @self: an #i3ipcConnection
+ * @event: a single type of event
+ * @change: (allow-none): the change of the policy, as given to
+ * i3ipc_connection_set_coalesce()
+ *
+ * Returns: how many events the policy dropped in favor of later ones, or 0
+ * when there is no such policy
+ */
+guint64 i3ipc_connection_get_coalesced(i3ipcConnection *self, i3ipcEvent event,
+                                       const gchar *change) {
+    i3ipcCoalescePolicy *policy;
+    GQuark detail = (change != NULL ? g_quark_try_string(change) : 0);
+    guint64 suppressed = 0;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(self), 0);
+    g_return_val_if_fail(event != 0 && (event & (event - 1)) == 0, 0);
+
+    if (change != NULL && detail == 0) {
+        return 0;
+    }
+
+    g_mutex_lock(&self->priv->lock);
+
+    policy = ipc_coalesce_policy_find(self, g_bit_nth_lsf(event, -1), detail);
+
+    if (policy != NULL) {
+        suppressed = policy->suppressed;
     }
 
-    reader = json_reader_new(json_parser_get_root(parser));
+    g_mutex_unlock(&self->priv->lock);
+
+    return suppressed;
+}
+
+static gpointer ipc_parse_workspaces_reply(i3ipcConnection *self, JsonNode *root) {
+    JsonReader *reader;
+    GSList *retval = NULL;
+
+    reader = json_reader_new(root);
 
     int num_workspaces = json_reader_count_elements(reader);
 
@@ -1133,50 +4863,67 @@ GSList *i3ipc_connection_get_workspaces(i3ipcConnection *self, GError **err) {
         retval = g_slist_prepend(retval, workspace);
     }
 
-    g_free(reply);
     g_object_unref(reader);
-    g_object_unref(parser);
 
     return retval;
 }
 
+static const i3ipcReplyParser workspaces_reply_parser = {ipc_parse_workspaces_reply,
+                                                         ipc_workspace_reply_list_free};
+
 /**
- * i3ipc_connection_get_outputs:
+ * i3ipc_connection_get_workspaces:
  * @self: An #i3ipcConnection
  * @err: (allow-none): return location of a GError, or NULL
  *
- * Gets the current outputs. The reply will be a list of outputs
+ * Gets the current workspaces. The reply will be list workspaces
  *
- * Returns: (transfer full) (element-type i3ipcOutputReply): a list of outputs
+ * Returns: (transfer full) (element-type i3ipcWorkspaceReply): a list of workspaces
  */
-GSList *i3ipc_connection_get_outputs(i3ipcConnection *self, GError **err) {
-    JsonParser *parser;
-    JsonReader *reader;
-    gchar *reply;
-    GError *tmp_error = NULL;
-    GSList *retval = NULL;
-
+GSList *i3ipc_connection_get_workspaces(i3ipcConnection *self, GError **err) {
     g_return_val_if_fail(err == NULL || *err == NULL, NULL);
 
-    reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_GET_OUTPUTS, "", &tmp_error);
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_GET_WORKSPACES, "",
+                                  &workspaces_reply_parser, err);
+}
 
-    if (tmp_error != NULL) {
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+/**
+ * i3ipc_connection_get_workspaces_async:
+ * @self: An #i3ipcConnection
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Gets the current workspaces asynchronously. Call
+ * i3ipc_connection_get_workspaces_finish() from @callback to get the result.
+ */
+void i3ipc_connection_get_workspaces_async(i3ipcConnection *self, GCancellable *cancellable,
+                                           GAsyncReadyCallback callback, gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_GET_WORKSPACES, "",
+                                 &workspaces_reply_parser, i3ipc_connection_get_workspaces_async,
+                                 cancellable, callback, user_data);
+}
 
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &tmp_error);
+/**
+ * i3ipc_connection_get_workspaces_finish:
+ * @self: An #i3ipcConnection
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location of a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_get_workspaces_async().
+ *
+ * Returns: (transfer full) (element-type i3ipcWorkspaceReply): a list of workspaces
+ */
+GSList *i3ipc_connection_get_workspaces_finish(i3ipcConnection *self, GAsyncResult *result,
+                                               GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_get_workspaces_async, err);
+}
 
-    if (tmp_error != NULL) {
-        g_object_unref(parser);
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+static gpointer ipc_parse_outputs_reply(i3ipcConnection *self, JsonNode *root) {
+    JsonReader *reader;
+    GSList *retval = NULL;
 
-    reader = json_reader_new(json_parser_get_root(parser));
+    reader = json_reader_new(root);
 
     int num_outputs = json_reader_count_elements(reader);
 
@@ -1224,94 +4971,140 @@ GSList *i3ipc_connection_get_outputs(i3ipcConnection *self, GError **err) {
         retval = g_slist_prepend(retval, output);
     }
 
-    g_free(reply);
     g_object_unref(reader);
-    g_object_unref(parser);
 
     return retval;
 }
+
+static const i3ipcReplyParser outputs_reply_parser = {ipc_parse_outputs_reply,
+                                                      ipc_output_reply_list_free};
+
 /**
- * i3ipc_connection_get_tree:
+ * i3ipc_connection_get_outputs:
  * @self: An #i3ipcConnection
- * @err: (allow-none): return location for a GError, or NULL
+ * @err: (allow-none): return location of a GError, or NULL
  *
- * Gets the layout tree. i3 uses a tree as data structure which includes every
- * container.
+ * Gets the current outputs. The reply will be a list of outputs
  *
- * Returns: (transfer full): the root container
+ * Returns: (transfer full) (element-type i3ipcOutputReply): a list of outputs
  */
-i3ipcCon *i3ipc_connection_get_tree(i3ipcConnection *self, GError **err) {
-    JsonParser *parser;
-    GError *tmp_error = NULL;
-    i3ipcCon *retval;
-    gchar *reply;
-
+GSList *i3ipc_connection_get_outputs(i3ipcConnection *self, GError **err) {
     g_return_val_if_fail(err == NULL || *err == NULL, NULL);
 
-    reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_GET_TREE, "", &tmp_error);
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_GET_OUTPUTS, "", &outputs_reply_parser,
+                                  err);
+}
 
-    if (tmp_error != NULL) {
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+/**
+ * i3ipc_connection_get_outputs_async:
+ * @self: An #i3ipcConnection
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Gets the current outputs asynchronously. Call
+ * i3ipc_connection_get_outputs_finish() from @callback to get the result.
+ */
+void i3ipc_connection_get_outputs_async(i3ipcConnection *self, GCancellable *cancellable,
+                                        GAsyncReadyCallback callback, gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_GET_OUTPUTS, "", &outputs_reply_parser,
+                                 i3ipc_connection_get_outputs_async, cancellable, callback,
+                                 user_data);
+}
 
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &tmp_error);
+/**
+ * i3ipc_connection_get_outputs_finish:
+ * @self: An #i3ipcConnection
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location of a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_get_outputs_async().
+ *
+ * Returns: (transfer full) (element-type i3ipcOutputReply): a list of outputs
+ */
+GSList *i3ipc_connection_get_outputs_finish(i3ipcConnection *self, GAsyncResult *result,
+                                            GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_get_outputs_async, err);
+}
 
-    if (tmp_error != NULL) {
-        g_object_unref(parser);
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+static gpointer ipc_parse_tree_reply(i3ipcConnection *self, JsonNode *root) {
+    return i3ipc_con_new(NULL, json_node_get_object(root), self);
+}
 
-    retval = i3ipc_con_new(NULL, json_node_get_object(json_parser_get_root(parser)), self);
+static const i3ipcReplyParser tree_reply_parser = {ipc_parse_tree_reply, g_object_unref};
 
-    g_object_unref(parser);
-    g_free(reply);
+/**
+ * i3ipc_connection_get_tree:
+ * @self: An #i3ipcConnection
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Gets the layout tree. i3 uses a tree as data structure which includes every
+ * container.
+ *
+ * Returns: (transfer full): the root container
+ */
+i3ipcCon *i3ipc_connection_get_tree(i3ipcConnection *self, GError **err) {
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
 
-    return retval;
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_GET_TREE, "", &tree_reply_parser, err);
 }
 
 /**
- * i3ipc_connection_get_marks:
+ * i3ipc_connection_get_tree_full:
  * @self: An #i3ipcConnection
+ * @priority: The #i3ipcMessagePriority of the query
  * @err: (allow-none): return location for a GError, or NULL
  *
- * Gets a list of marks (identifiers for containers to easily jump to them
- * later). The reply will be a list of window marks.
+ * Gets the layout tree with the given priority. See
+ * i3ipc_connection_message_full().
  *
- * Returns: (transfer full) (element-type utf8): a list of strings representing marks
+ * Returns: (transfer full): the root container
  */
-GSList *i3ipc_connection_get_marks(i3ipcConnection *self, GError **err) {
-    JsonParser *parser;
-    JsonReader *reader;
-    gchar *reply;
-    GError *tmp_error = NULL;
-    GSList *retval = NULL;
-
+i3ipcCon *i3ipc_connection_get_tree_full(i3ipcConnection *self, i3ipcMessagePriority priority,
+                                         GError **err) {
     g_return_val_if_fail(err == NULL || *err == NULL, NULL);
 
-    reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_GET_MARKS, "", &tmp_error);
+    return i3ipc_connection_query_full(self, I3IPC_MESSAGE_TYPE_GET_TREE, "", &tree_reply_parser,
+                                       priority, err);
+}
 
-    if (tmp_error != NULL) {
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+/**
+ * i3ipc_connection_get_tree_async:
+ * @self: An #i3ipcConnection
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Gets the layout tree asynchronously. Call i3ipc_connection_get_tree_finish()
+ * from @callback to get the result.
+ */
+void i3ipc_connection_get_tree_async(i3ipcConnection *self, GCancellable *cancellable,
+                                     GAsyncReadyCallback callback, gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_GET_TREE, "", &tree_reply_parser,
+                                 i3ipc_connection_get_tree_async, cancellable, callback,
+                                 user_data);
+}
 
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &tmp_error);
+/**
+ * i3ipc_connection_get_tree_finish:
+ * @self: An #i3ipcConnection
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_get_tree_async().
+ *
+ * Returns: (transfer full): the root container
+ */
+i3ipcCon *i3ipc_connection_get_tree_finish(i3ipcConnection *self, GAsyncResult *result,
+                                           GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_get_tree_async, err);
+}
 
-    if (tmp_error != NULL) {
-        g_object_unref(parser);
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+static gpointer ipc_parse_string_list_reply(i3ipcConnection *self, JsonNode *root) {
+    JsonReader *reader;
+    GSList *retval = NULL;
 
-    reader = json_reader_new(json_parser_get_root(parser));
+    reader = json_reader_new(root);
 
     int num_elements = json_reader_count_elements(reader);
 
@@ -1321,108 +5114,124 @@ GSList *i3ipc_connection_get_marks(i3ipcConnection *self, GError **err) {
         json_reader_end_element(reader);
     }
 
-    g_free(reply);
     g_object_unref(reader);
-    g_object_unref(parser);
 
     return retval;
 }
 
+static const i3ipcReplyParser string_list_reply_parser = {ipc_parse_string_list_reply,
+                                                          ipc_string_list_free};
+
 /**
- * i3ipc_connection_get_bar_config_list:
+ * i3ipc_connection_get_marks:
  * @self: An #i3ipcConnection
  * @err: (allow-none): return location for a GError, or NULL
  *
- * Gets a list of all configured bar ids.
+ * Gets a list of marks (identifiers for containers to easily jump to them
+ * later). The reply will be a list of window marks.
  *
- * Returns: (transfer full) (element-type utf8): the configured bar ids
+ * Returns: (transfer full) (element-type utf8): a list of strings representing marks
  */
-GSList *i3ipc_connection_get_bar_config_list(i3ipcConnection *self, GError **err) {
-    JsonParser *parser;
-    JsonReader *reader;
-    gchar *reply;
-    GError *tmp_error = NULL;
-    GSList *retval = NULL;
-
+GSList *i3ipc_connection_get_marks(i3ipcConnection *self, GError **err) {
     g_return_val_if_fail(err == NULL || *err == NULL, NULL);
 
-    reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_GET_BAR_CONFIG, "", &tmp_error);
-
-    if (tmp_error != NULL) {
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
-
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &tmp_error);
-
-    if (tmp_error != NULL) {
-        g_object_unref(parser);
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_GET_MARKS, "", &string_list_reply_parser,
+                                  err);
+}
 
-    reader = json_reader_new(json_parser_get_root(parser));
+/**
+ * i3ipc_connection_get_marks_async:
+ * @self: An #i3ipcConnection
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Gets the list of marks asynchronously. Call
+ * i3ipc_connection_get_marks_finish() from @callback to get the result.
+ */
+void i3ipc_connection_get_marks_async(i3ipcConnection *self, GCancellable *cancellable,
+                                      GAsyncReadyCallback callback, gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_GET_MARKS, "", &string_list_reply_parser,
+                                 i3ipc_connection_get_marks_async, cancellable, callback,
+                                 user_data);
+}
 
-    int num_elements = json_reader_count_elements(reader);
+/**
+ * i3ipc_connection_get_marks_finish:
+ * @self: An #i3ipcConnection
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_get_marks_async().
+ *
+ * Returns: (transfer full) (element-type utf8): a list of strings representing marks
+ */
+GSList *i3ipc_connection_get_marks_finish(i3ipcConnection *self, GAsyncResult *result,
+                                          GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_get_marks_async, err);
+}
 
-    for (int i = 0; i < num_elements; i += 1) {
-        json_reader_read_element(reader, i);
-        retval = g_slist_prepend(retval, g_strdup(json_reader_get_string_value(reader)));
-        json_reader_end_element(reader);
-    }
+/**
+ * i3ipc_connection_get_bar_config_list:
+ * @self: An #i3ipcConnection
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Gets a list of all configured bar ids.
+ *
+ * Returns: (transfer full) (element-type utf8): the configured bar ids
+ */
+GSList *i3ipc_connection_get_bar_config_list(i3ipcConnection *self, GError **err) {
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
 
-    g_free(reply);
-    g_object_unref(reader);
-    g_object_unref(parser);
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_GET_BAR_CONFIG, "",
+                                  &string_list_reply_parser, err);
+}
 
-    return retval;
+/**
+ * i3ipc_connection_get_bar_config_list_async:
+ * @self: An #i3ipcConnection
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Gets the list of configured bar ids asynchronously. Call
+ * i3ipc_connection_get_bar_config_list_finish() from @callback to get the
+ * result.
+ */
+void i3ipc_connection_get_bar_config_list_async(i3ipcConnection *self, GCancellable *cancellable,
+                                                GAsyncReadyCallback callback,
+                                                gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_GET_BAR_CONFIG, "",
+                                 &string_list_reply_parser,
+                                 i3ipc_connection_get_bar_config_list_async, cancellable, callback,
+                                 user_data);
 }
 
 /**
- * i3ipc_connection_get_bar_config:
+ * i3ipc_connection_get_bar_config_list_finish:
  * @self: An #i3ipcConnection
- * @bar_id: The id of the particular bar
+ * @result: the #GAsyncResult passed to the callback
  * @err: (allow-none): return location for a GError, or NULL
  *
- * Gets the configuration of the workspace bar with the given ID.
+ * Finishes an operation started with
+ * i3ipc_connection_get_bar_config_list_async().
  *
- * Returns: (transfer full): the bar config reply
+ * Returns: (transfer full) (element-type utf8): the configured bar ids
  */
-i3ipcBarConfigReply *i3ipc_connection_get_bar_config(i3ipcConnection *self, const gchar *bar_id,
-                                                     GError **err) {
-    JsonParser *parser;
+GSList *i3ipc_connection_get_bar_config_list_finish(i3ipcConnection *self, GAsyncResult *result,
+                                                    GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_get_bar_config_list_async,
+                                         err);
+}
+
+static gpointer ipc_parse_bar_config_reply(i3ipcConnection *self, JsonNode *root) {
     JsonReader *reader;
-    gchar *reply;
     gchar **colors_list;
-    GError *tmp_error = NULL;
-
-    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
-
-    reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_GET_BAR_CONFIG, bar_id, &tmp_error);
-
-    if (tmp_error != NULL) {
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
 
     i3ipcBarConfigReply *retval = g_slice_new0(i3ipcBarConfigReply);
     retval->colors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &tmp_error);
-
-    if (tmp_error != NULL) {
-        g_object_unref(parser);
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
-
-    reader = json_reader_new(json_parser_get_root(parser));
+    reader = json_reader_new(root);
     json_reader_read_member(reader, "id");
     retval->id = g_strdup(json_reader_get_string_value(reader));
     json_reader_end_member(reader);
@@ -1473,51 +5282,72 @@ i3ipcBarConfigReply *i3ipc_connection_get_bar_config(i3ipcConnection *self, cons
 
     g_strfreev(colors_list);
     g_object_unref(reader);
-    g_object_unref(parser);
-    g_free(reply);
 
     return retval;
 }
 
+static const i3ipcReplyParser bar_config_reply_parser = {
+    ipc_parse_bar_config_reply, (GDestroyNotify)i3ipc_bar_config_reply_free};
+
 /**
- * i3ipc_connection_get_version:
+ * i3ipc_connection_get_bar_config:
  * @self: An #i3ipcConnection
+ * @bar_id: The id of the particular bar
  * @err: (allow-none): return location for a GError, or NULL
  *
- * Gets the version of i3. The reply will be a boxed structure with the major,
- * minor, patch and human-readable version.
+ * Gets the configuration of the workspace bar with the given ID.
  *
- * Returns: (transfer full): an #i3ipcVersionReply
+ * Returns: (transfer full): the bar config reply
  */
-i3ipcVersionReply *i3ipc_connection_get_version(i3ipcConnection *self, GError **err) {
-    JsonParser *parser;
-    JsonReader *reader;
-    gchar *reply;
-    GError *tmp_error = NULL;
-
+i3ipcBarConfigReply *i3ipc_connection_get_bar_config(i3ipcConnection *self, const gchar *bar_id,
+                                                     GError **err) {
     g_return_val_if_fail(err == NULL || *err == NULL, NULL);
 
-    reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_GET_VERSION, "", &tmp_error);
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_GET_BAR_CONFIG, bar_id,
+                                  &bar_config_reply_parser, err);
+}
 
-    if (tmp_error != NULL) {
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+/**
+ * i3ipc_connection_get_bar_config_async:
+ * @self: An #i3ipcConnection
+ * @bar_id: The id of the particular bar
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Gets the configuration of the workspace bar with the given ID
+ * asynchronously. Call i3ipc_connection_get_bar_config_finish() from @callback
+ * to get the result.
+ */
+void i3ipc_connection_get_bar_config_async(i3ipcConnection *self, const gchar *bar_id,
+                                           GCancellable *cancellable, GAsyncReadyCallback callback,
+                                           gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_GET_BAR_CONFIG, bar_id,
+                                 &bar_config_reply_parser, i3ipc_connection_get_bar_config_async,
+                                 cancellable, callback, user_data);
+}
 
-    i3ipcVersionReply *retval = g_slice_new0(i3ipcVersionReply);
+/**
+ * i3ipc_connection_get_bar_config_finish:
+ * @self: An #i3ipcConnection
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_get_bar_config_async().
+ *
+ * Returns: (transfer full): the bar config reply
+ */
+i3ipcBarConfigReply *i3ipc_connection_get_bar_config_finish(i3ipcConnection *self,
+                                                            GAsyncResult *result, GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_get_bar_config_async, err);
+}
 
-    parser = json_parser_new();
-    json_parser_load_from_data(parser, reply, -1, &tmp_error);
+static gpointer ipc_parse_version_reply(i3ipcConnection *self, JsonNode *root) {
+    JsonReader *reader;
 
-    if (tmp_error != NULL) {
-        g_object_unref(parser);
-        g_free(reply);
-        g_propagate_error(err, tmp_error);
-        return NULL;
-    }
+    i3ipcVersionReply *retval = g_slice_new0(i3ipcVersionReply);
 
-    reader = json_reader_new(json_parser_get_root(parser));
+    reader = json_reader_new(root);
     json_reader_read_member(reader, "major");
     retval->major = json_reader_get_int_value(reader);
     json_reader_end_member(reader);
@@ -1535,12 +5365,64 @@ i3ipcVersionReply *i3ipc_connection_get_version(i3ipcConnection *self, GError **
     json_reader_end_member(reader);
 
     g_object_unref(reader);
-    g_object_unref(parser);
-    g_free(reply);
 
     return retval;
 }
 
+static const i3ipcReplyParser version_reply_parser = {
+    ipc_parse_version_reply, (GDestroyNotify)i3ipc_version_reply_free};
+
+/**
+ * i3ipc_connection_get_version:
+ * @self: An #i3ipcConnection
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Gets the version of i3. The reply will be a boxed structure with the major,
+ * minor, patch and human-readable version.
+ *
+ * Returns: (transfer full): an #i3ipcVersionReply
+ */
+i3ipcVersionReply *i3ipc_connection_get_version(i3ipcConnection *self, GError **err) {
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_GET_VERSION, "", &version_reply_parser,
+                                  err);
+}
+
+/**
+ * i3ipc_connection_get_version_async:
+ * @self: An #i3ipcConnection
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Gets the version of i3 asynchronously. Call
+ * i3ipc_connection_get_version_finish() from @callback to get the result.
+ */
+void i3ipc_connection_get_version_async(i3ipcConnection *self, GCancellable *cancellable,
+                                        GAsyncReadyCallback callback, gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_GET_VERSION, "", &version_reply_parser,
+                                 i3ipc_connection_get_version_async, cancellable, callback,
+                                 user_data);
+}
+
+/**
+ * i3ipc_connection_get_version_finish:
+ * @self: An #i3ipcConnection
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_get_version_async().
+ *
+ * Returns: (transfer full): an #i3ipcVersionReply
+ */
+i3ipcVersionReply *i3ipc_connection_get_version_finish(i3ipcConnection *self,
+                                                       GAsyncResult *result, GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_get_version_async, err);
+}
+
+static const i3ipcReplyParser config_reply_parser = {NULL, g_free};
+
 /**
  * i3ipc_connection_get_config:
  * @self: An #i3ipcConnection
@@ -1551,20 +5433,272 @@ i3ipcVersionReply *i3ipc_connection_get_version(i3ipcConnection *self, GError **
  * Returns: (transfer full): an *gchar
  */
 gchar *i3ipc_connection_get_config(i3ipcConnection *self, GError **err) {
-    gchar *reply;
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+
+    return i3ipc_connection_query(self, I3IPC_MESSAGE_TYPE_GET_CONFIG, "", &config_reply_parser,
+                                  err);
+}
+
+/**
+ * i3ipc_connection_get_config_async:
+ * @self: An #i3ipcConnection
+ * @cancellable: (allow-none): a #GCancellable, or NULL
+ * @callback: (scope async): the function to call when the reply arrives
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Gets the config of i3 asynchronously. Call
+ * i3ipc_connection_get_config_finish() from @callback to get the result.
+ */
+void i3ipc_connection_get_config_async(i3ipcConnection *self, GCancellable *cancellable,
+                                       GAsyncReadyCallback callback, gpointer user_data) {
+    i3ipc_connection_query_async(self, I3IPC_MESSAGE_TYPE_GET_CONFIG, "", &config_reply_parser,
+                                 i3ipc_connection_get_config_async, cancellable, callback,
+                                 user_data);
+}
+
+/**
+ * i3ipc_connection_get_config_finish:
+ * @self: An #i3ipcConnection
+ * @result: the #GAsyncResult passed to the callback
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Finishes an operation started with i3ipc_connection_get_config_async().
+ *
+ * Returns: (transfer full): an *gchar
+ */
+gchar *i3ipc_connection_get_config_finish(i3ipcConnection *self, GAsyncResult *result,
+                                          GError **err) {
+    return i3ipc_connection_query_finish(self, result, i3ipc_connection_get_config_async, err);
+}
+
+/**
+ * i3ipc_connection_attach:
+ * @self: An #i3ipcConnection
+ * @context: (allow-none): The context to emit the events from, or NULL for the
+ * thread-default context
+ *
+ * Moves the processing of events to @context. The signals of the connection
+ * are emitted from the thread that runs @context, with the priority given by
+ * #i3ipcConnection:event-priority. Events that were received but not emitted
+ * yet are kept.
+ *
+ * The connection attaches itself to the thread-default context of the thread
+ * that creates it. The subscription socket is only opened with the first
+ * subscription, and the events are processed in @context from then on.
+ *
+ * With #i3ipcConnection:event-thread set, the events are read and decoded in
+ * a thread of the connection instead, and @context only emits the signals.
+ * This keeps the parsing of large events such as the window events off the
+ * thread of a user interface.
+ */
+void i3ipc_connection_attach(i3ipcConnection *self, GMainContext *context) {
+    g_return_if_fail(I3IPC_IS_CONNECTION(self));
+
+    if (!ipc_ensure_init(self, NULL)) {
+        return;
+    }
+
+    if (context == NULL) {
+        context = g_main_context_get_thread_default();
+    }
+
+    if (context == NULL) {
+        context = g_main_context_default();
+    }
+
+    ipc_attach_events(self, context);
+}
+
+/**
+ * i3ipc_connection_detach:
+ * @self: An #i3ipcConnection
+ *
+ * Stops processing events from a #GMainContext. The events are then only
+ * emitted from i3ipc_connection_dispatch_ready(), so the connection can be
+ * driven by an event loop that is not GLib. This also stops the thread of
+ * #i3ipcConnection:event-thread.
+ */
+void i3ipc_connection_detach(i3ipcConnection *self) {
+    g_return_if_fail(I3IPC_IS_CONNECTION(self));
+
+    self->priv->events_detached = TRUE;
+    ipc_event_reader_stop(self);
+
+    if (self->priv->sub_source != NULL) {
+        g_source_destroy(self->priv->sub_source);
+        g_clear_pointer(&self->priv->sub_source, g_source_unref);
+    }
+}
+
+/**
+ * i3ipc_connection_get_event_fd:
+ * @self: An #i3ipcConnection
+ *
+ * Gets the file descriptor of the socket the events are received on. It is
+ * owned by the connection and must not be read from or closed. The socket is
+ * opened if no subscription did so yet.
+ *
+ * Returns: the file descriptor, or -1 when the connection is not connected
+ */
+gint i3ipc_connection_get_event_fd(i3ipcConnection *self) {
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(self), -1);
+
+    if (!ipc_ensure_init(self, NULL) || !ipc_open_events(self, NULL)) {
+        return -1;
+    }
+
+    return ipc_event_fd(self);
+}
+
+/**
+ * i3ipc_connection_get_event_condition:
+ * @self: An #i3ipcConnection
+ *
+ * Gets the conditions to wait for on the fd returned by
+ * i3ipc_connection_get_event_fd() before calling
+ * i3ipc_connection_dispatch_ready().
+ *
+ * Returns: the conditions, or 0 when the connection is not connected
+ */
+GIOCondition i3ipc_connection_get_event_condition(i3ipcConnection *self) {
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(self), 0);
+
+    if (!self->priv->connected) {
+        return 0;
+    }
+
+    return G_IO_IN | G_IO_HUP | G_IO_ERR;
+}
+
+/**
+ * i3ipc_connection_get_command_fd:
+ * @self: An #i3ipcConnection
+ *
+ * Gets the file descriptor of the socket the replies to the asynchronous
+ * requests are received on. It is owned by the connection and must not be
+ * read from or closed.
+ *
+ * Returns: the file descriptor, or -1 when the connection is not connected
+ */
+gint i3ipc_connection_get_command_fd(i3ipcConnection *self) {
+    gint fd = -1;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(self), -1);
+
+    if (!ipc_ensure_init(self, NULL)) {
+        return -1;
+    }
+
+    /* the channel is gone while the connection is lost */
+    g_mutex_lock(&self->priv->cmd_lane.send_lock);
+
+    if (self->priv->cmd_lane.channel != NULL) {
+        fd = g_io_channel_unix_get_fd(self->priv->cmd_lane.channel);
+    }
+
+    g_mutex_unlock(&self->priv->cmd_lane.send_lock);
+
+    return fd;
+}
+
+/**
+ * i3ipc_connection_get_command_condition:
+ * @self: An #i3ipcConnection
+ *
+ * Gets the conditions to wait for on the fd returned by
+ * i3ipc_connection_get_command_fd(). The fd only needs to be watched while
+ * requests are waiting for their replies, so this changes with every request
+ * and has to be checked again after each dispatch.
+ *
+ * Returns: the conditions, or 0 when no reply is expected
+ */
+GIOCondition i3ipc_connection_get_command_condition(i3ipcConnection *self) {
+    GIOCondition condition = G_IO_IN | G_IO_HUP | G_IO_ERR;
+
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(self), 0);
+
+    g_mutex_lock(&self->priv->lock);
+
+    if (!self->priv->connected || g_queue_is_empty(self->priv->cmd_lane.pending)) {
+        condition = 0;
+    }
+
+    g_mutex_unlock(&self->priv->lock);
+
+    return condition;
+}
+
+/**
+ * i3ipc_connection_dispatch_ready:
+ * @self: An #i3ipcConnection
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Processes whatever can be read from the sockets of the connection without
+ * blocking. Replies are handed to the requests waiting for them, and the
+ * signals are emitted for every complete event, including the events that
+ * were buffered while waiting for the reply to a subscription.
+ *
+ * Call this when one of the fds of the connection becomes ready, and once
+ * after every call to i3ipc_connection_subscribe().
+ *
+ * The callbacks of asynchronous requests are still invoked from the
+ * #GMainContext the requests were made from.
+ *
+ * Returns: FALSE if the connection was lost or the ipc sent invalid data
+ */
+gboolean i3ipc_connection_dispatch_ready(i3ipcConnection *self, GError **err) {
     GError *tmp_error = NULL;
+    GIOStatus status;
+    gboolean waiting;
 
-    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+    g_return_val_if_fail(I3IPC_IS_CONNECTION(self), FALSE);
+    g_return_val_if_fail(err == NULL || *err == NULL, FALSE);
 
-    reply = i3ipc_connection_message(self, I3IPC_MESSAGE_TYPE_GET_CONFIG, "", &tmp_error);
+    if (!ipc_ensure_init(self, err)) {
+        return FALSE;
+    }
+
+    g_object_ref(self);
+
+    g_mutex_lock(&self->priv->lock);
+    waiting = !g_queue_is_empty(self->priv->cmd_lane.pending);
+    g_mutex_unlock(&self->priv->lock);
+
+    /* when another thread is reading, it hands out the replies */
+    if (waiting) {
+        ipc_try_read_replies(self, &self->priv->cmd_lane);
+    }
+
+    if (self->priv->sub_channel == NULL) {
+        /* nothing subscribed yet, so there are no events to read */
+        g_object_unref(self);
+        return TRUE;
+    }
+
+    if (self->priv->event_reader != NULL) {
+        /* the event thread reads the socket */
+        ipc_emit_queued_events(self, self->priv->sub_source);
+        g_object_unref(self);
+        return TRUE;
+    }
+
+    status = ipc_read_events(self, TRUE, &tmp_error);
+    ipc_emit_queued_events(self, self->priv->sub_source);
+
+    if (tmp_error == NULL && status == G_IO_STATUS_EOF) {
+        tmp_error = g_error_new(G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED,
+                                "The ipc connection was closed");
+        ipc_on_shutdown(self);
+    }
+
+    g_object_unref(self);
 
     if (tmp_error != NULL) {
-        g_free(reply);
         g_propagate_error(err, tmp_error);
-        return NULL;
+        return FALSE;
     }
 
-    return reply;
+    return TRUE;
 }
 
 /**
@@ -1573,13 +5707,11 @@ gchar *i3ipc_connection_get_config(i3ipcConnection *self, GError **err) {
  *
  * A convenience function for scripts to run a main loop and wait for events.
  * The main loop will terminate when the connection to the ipc is lost, such as
- * when i3 shuts down or restarts.
+ * when i3 shuts down or restarts, unless #i3ipcConnection:auto-reconnect is
+ * set.
  */
 void i3ipc_connection_main(i3ipcConnection *self) {
-    self->priv->main_loop = g_main_loop_new(NULL, FALSE);
-    g_main_loop_run(self->priv->main_loop);
-    g_main_loop_unref(self->priv->main_loop);
-    self->priv->main_loop = NULL;
+    i3ipc_connection_main_with_context(self, NULL);
 }
 
 /**
@@ -1588,10 +5720,25 @@ void i3ipc_connection_main(i3ipcConnection *self) {
  * @context: A context to give g_main_loop_new
  *
  * A convenience function for scripts to run a main loop with custom context and wait for events.
+ * The events are moved to @context first if they are processed elsewhere.
  * The main loop will terminate when the connection to the ipc is lost, such as
  * when i3 shuts down or restarts.
  */
 void i3ipc_connection_main_with_context(i3ipcConnection *self, GMainContext *context) {
+    GMainContext *events_context = (context != NULL ? context : g_main_context_default());
+    GError *err = NULL;
+
+    /* the loss of the connection is noticed on the subscription socket */
+    if (!ipc_ensure_init(self, &err) || !ipc_open_events(self, &err)) {
+        g_warning("could not open the event socket (%s)\n", err->message);
+        g_error_free(err);
+    }
+
+    if (self->priv->sub_source != NULL &&
+        g_source_get_context(self->priv->sub_source) != events_context) {
+        i3ipc_connection_attach(self, events_context);
+    }
+
     self->priv->main_loop = g_main_loop_new(context, FALSE);
     g_main_loop_run(self->priv->main_loop);
     g_main_loop_unref(self->priv->main_loop);
@@ -21,11 +21,14 @@
 #ifndef __I3IPC_CONNECTION_H__
 #define __I3IPC_CONNECTION_H__
 
+#include <gio/gio.h>
 #include <glib-object.h>
+#include <sys/uio.h>
 
 #include "i3ipc-con.h"
 #include "i3ipc-event-types.h"
 #include "i3ipc-reply-types.h"
+#include "i3ipc-transport.h"
 
 #define I3IPC_MAGIC "i3-ipc"
 
@@ -38,6 +41,16 @@
  * of the workspaces, windows, etc. You can also subscribe to events such as
  * when certain window or workspace properties change.
  *
+ * Once constructed, a connection can be shared by several threads. Their
+ * messages are sent one after the other on the same socket, and every thread
+ * gets the reply to its own message. Messages sent with
+ * %I3IPC_MESSAGE_PRIORITY_HIGH skip that queue on a second socket. The events
+ * are dispatched from the #GMainContext the connection is attached to.
+ *
+ * An event is only parsed when a handler is connected for its signal and
+ * detail at the time it is read, so subscribing to a whole event type to get
+ * a single change of it costs little for the other changes.
+ *
  */
 
 #define I3IPC_TYPE_CONNECTION (i3ipc_connection_get_type())
@@ -84,6 +97,21 @@ typedef enum { /*< underscore_name=i3ipc_message_type >*/
                I3IPC_MESSAGE_TYPE_GET_CONFIG,
 } i3ipcMessageType;
 
+/**
+ * i3ipcMessagePriority:
+ * @I3IPC_MESSAGE_PRIORITY_NORMAL: The message is sent on the command socket
+ * of the connection along with all the other messages.
+ * @I3IPC_MESSAGE_PRIORITY_HIGH: The message is sent on a socket of its own,
+ * so it does not wait behind the replies to the normal messages.
+ *
+ * The priority of a synchronous message sent with
+ * i3ipc_connection_message_full().
+ */
+typedef enum { /*< underscore_name=i3ipc_message_priority >*/
+               I3IPC_MESSAGE_PRIORITY_NORMAL,
+               I3IPC_MESSAGE_PRIORITY_HIGH,
+} i3ipcMessagePriority;
+
 struct _i3ipcConnection {
     GObject parent_instance;
 
@@ -101,36 +129,155 @@ GType i3ipc_connection_get_type(void);
 
 i3ipcConnection *i3ipc_connection_new(const gchar *socket_path, GError **err);
 
+i3ipcConnection *i3ipc_connection_new_with_transport(i3ipcTransport *transport, GError **err);
+
+void i3ipc_connection_new_async(const gchar *socket_path, GCancellable *cancellable,
+                                GAsyncReadyCallback callback, gpointer user_data);
+
+i3ipcConnection *i3ipc_connection_new_finish(GAsyncResult *result, GError **err);
+
+i3ipcConnection *i3ipc_connection_new_wait(const gchar *socket_path, gint timeout, GError **err);
+
 /* Method definitions */
 
 gchar *i3ipc_connection_message(i3ipcConnection *self, i3ipcMessageType message_type,
                                 const gchar *payload, GError **err);
 
+gchar *i3ipc_connection_message_full(i3ipcConnection *self, i3ipcMessageType message_type,
+                                     const gchar *payload, i3ipcMessagePriority priority,
+                                     gint timeout, GCancellable *cancellable, GError **err);
+
+gchar *i3ipc_connection_message_v(i3ipcConnection *self, i3ipcMessageType message_type,
+                                  const struct iovec *payload, gint n_payload, GError **err);
+
+gchar *i3ipc_connection_message_bytes(i3ipcConnection *self, i3ipcMessageType message_type,
+                                      GBytes *payload, GError **err);
+
+GBytes *i3ipc_connection_message_raw(i3ipcConnection *self, i3ipcMessageType message_type,
+                                     const gchar *payload, GError **err);
+
+GPtrArray *i3ipc_connection_message_pipelined(i3ipcConnection *self,
+                                              const i3ipcMessageType *message_types,
+                                              const gchar *const *payloads, guint n_messages,
+                                              GError **err);
+
+void i3ipc_connection_message_async(i3ipcConnection *self, i3ipcMessageType message_type,
+                                    const gchar *payload, GCancellable *cancellable,
+                                    GAsyncReadyCallback callback, gpointer user_data);
+
+gchar *i3ipc_connection_message_finish(i3ipcConnection *self, GAsyncResult *result,
+                                       GError **err);
+
 GSList *i3ipc_connection_command(i3ipcConnection *self, const gchar *command, GError **err);
 
+GSList *i3ipc_connection_command_full(i3ipcConnection *self, const gchar *command,
+                                      i3ipcMessagePriority priority, GError **err);
+
+void i3ipc_connection_command_async(i3ipcConnection *self, const gchar *command,
+                                    GCancellable *cancellable, GAsyncReadyCallback callback,
+                                    gpointer user_data);
+
+GSList *i3ipc_connection_command_finish(i3ipcConnection *self, GAsyncResult *result,
+                                        GError **err);
+
 i3ipcCommandReply *i3ipc_connection_subscribe(i3ipcConnection *self, i3ipcEvent events,
                                               GError **err);
 
 i3ipcConnection *i3ipc_connection_on(i3ipcConnection *self, const gchar *event, GClosure *callback,
                                      GError **err);
 
+guint i3ipc_connection_get_event_handlers(i3ipcConnection *self, i3ipcEvent events);
+
+void i3ipc_connection_set_coalesce(i3ipcConnection *self, i3ipcEvent event, const gchar *change,
+                                   guint interval);
+
+guint64 i3ipc_connection_get_coalesced(i3ipcConnection *self, i3ipcEvent event,
+                                       const gchar *change);
+
 GSList *i3ipc_connection_get_workspaces(i3ipcConnection *self, GError **err);
 
+void i3ipc_connection_get_workspaces_async(i3ipcConnection *self, GCancellable *cancellable,
+                                           GAsyncReadyCallback callback, gpointer user_data);
+
+GSList *i3ipc_connection_get_workspaces_finish(i3ipcConnection *self, GAsyncResult *result,
+                                               GError **err);
+
 GSList *i3ipc_connection_get_outputs(i3ipcConnection *self, GError **err);
 
+void i3ipc_connection_get_outputs_async(i3ipcConnection *self, GCancellable *cancellable,
+                                        GAsyncReadyCallback callback, gpointer user_data);
+
+GSList *i3ipc_connection_get_outputs_finish(i3ipcConnection *self, GAsyncResult *result,
+                                            GError **err);
+
 i3ipcCon *i3ipc_connection_get_tree(i3ipcConnection *self, GError **err);
 
+i3ipcCon *i3ipc_connection_get_tree_full(i3ipcConnection *self, i3ipcMessagePriority priority,
+                                         GError **err);
+
+void i3ipc_connection_get_tree_async(i3ipcConnection *self, GCancellable *cancellable,
+                                     GAsyncReadyCallback callback, gpointer user_data);
+
+i3ipcCon *i3ipc_connection_get_tree_finish(i3ipcConnection *self, GAsyncResult *result,
+                                           GError **err);
+
 GSList *i3ipc_connection_get_marks(i3ipcConnection *self, GError **err);
 
+void i3ipc_connection_get_marks_async(i3ipcConnection *self, GCancellable *cancellable,
+                                      GAsyncReadyCallback callback, gpointer user_data);
+
+GSList *i3ipc_connection_get_marks_finish(i3ipcConnection *self, GAsyncResult *result,
+                                          GError **err);
+
 GSList *i3ipc_connection_get_bar_config_list(i3ipcConnection *self, GError **err);
 
+void i3ipc_connection_get_bar_config_list_async(i3ipcConnection *self, GCancellable *cancellable,
+                                                GAsyncReadyCallback callback,
+                                                gpointer user_data);
+
+GSList *i3ipc_connection_get_bar_config_list_finish(i3ipcConnection *self, GAsyncResult *result,
+                                                    GError **err);
+
 i3ipcBarConfigReply *i3ipc_connection_get_bar_config(i3ipcConnection *self, const gchar *bar_id,
                                                      GError **err);
 
+void i3ipc_connection_get_bar_config_async(i3ipcConnection *self, const gchar *bar_id,
+                                           GCancellable *cancellable, GAsyncReadyCallback callback,
+                                           gpointer user_data);
+
+i3ipcBarConfigReply *i3ipc_connection_get_bar_config_finish(i3ipcConnection *self,
+                                                            GAsyncResult *result, GError **err);
+
 i3ipcVersionReply *i3ipc_connection_get_version(i3ipcConnection *self, GError **err);
 
+void i3ipc_connection_get_version_async(i3ipcConnection *self, GCancellable *cancellable,
+                                        GAsyncReadyCallback callback, gpointer user_data);
+
+i3ipcVersionReply *i3ipc_connection_get_version_finish(i3ipcConnection *self,
+                                                       GAsyncResult *result, GError **err);
+
 gchar *i3ipc_connection_get_config(i3ipcConnection *self, GError **err);
 
+void i3ipc_connection_get_config_async(i3ipcConnection *self, GCancellable *cancellable,
+                                       GAsyncReadyCallback callback, gpointer user_data);
+
+gchar *i3ipc_connection_get_config_finish(i3ipcConnection *self, GAsyncResult *result,
+                                          GError **err);
+
+void i3ipc_connection_attach(i3ipcConnection *self, GMainContext *context);
+
+void i3ipc_connection_detach(i3ipcConnection *self);
+
+gint i3ipc_connection_get_event_fd(i3ipcConnection *self);
+
+GIOCondition i3ipc_connection_get_event_condition(i3ipcConnection *self);
+
+gint i3ipc_connection_get_command_fd(i3ipcConnection *self);
+
+GIOCondition i3ipc_connection_get_command_condition(i3ipcConnection *self);
+
+gboolean i3ipc_connection_dispatch_ready(i3ipcConnection *self, GError **err);
+
 void i3ipc_connection_main(i3ipcConnection *self);
 
 void i3ipc_connection_main_with_context(i3ipcConnection *self, GMainContext *context);
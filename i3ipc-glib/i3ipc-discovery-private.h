@@ -0,0 +1,48 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ *
+ */
+
+#ifndef __I3IPC_DISCOVERY_PRIVATE_H__
+#define __I3IPC_DISCOVERY_PRIVATE_H__
+
+#include <glib.h>
+
+/*
+ * Finds the ipc socket of the running window manager without a round trip to
+ * the X server when possible. The X server is only asked when the library was
+ * built with xcb. Fails with G_IO_ERROR_NOT_FOUND while the window manager has
+ * not published a socket yet.
+ */
+gchar *i3ipc_discover_socket_path(GError **err);
+
+void i3ipc_discovery_forget(const gchar *socket_path);
+
+/*
+ * Waits for the directories a socket can appear in to change, with inotify
+ * where it is available.
+ */
+typedef struct _i3ipcSocketWatch i3ipcSocketWatch;
+
+i3ipcSocketWatch *i3ipc_socket_watch_new(const gchar *socket_path);
+
+gboolean i3ipc_socket_watch_wait(i3ipcSocketWatch *watch, gint64 deadline);
+
+void i3ipc_socket_watch_free(i3ipcSocketWatch *watch);
+
+#endif /* __I3IPC_DISCOVERY_PRIVATE_H__ */
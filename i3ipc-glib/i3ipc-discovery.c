@@ -0,0 +1,431 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ */
+
+#include "i3ipc-discovery-private.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#ifdef I3IPC_HAVE_XCB
+#include <xcb/xcb.h>
+#endif
+
+/* the name i3 gives its sockets in $XDG_RUNTIME_DIR/i3, followed by its pid */
+#define IPC_SOCKET_PREFIX "ipc-socket."
+
+/*
+ * How long a socket watch sleeps between checks, in ms. Right after a change
+ * the socket may exist without accepting connections yet, so the checks start
+ * out fast. Without a change, the idle interval covers sockets that only the
+ * X server knows about. Without inotify, the change interval is used throughout.
+ */
+#define WATCH_MIN_INTERVAL 1
+#define WATCH_CHANGE_INTERVAL 100
+#define WATCH_IDLE_INTERVAL 1000
+
+static gboolean is_socket(const gchar *path) {
+    struct stat st;
+
+    return (stat(path, &st) == 0 && S_ISSOCK(st.st_mode));
+}
+
+/*
+ * The file the last discovered path is kept in. There is one per display, so
+ * sessions of the same user on different displays do not share it.
+ */
+static gchar *cache_file_path(void) {
+    const gchar *display = g_getenv("DISPLAY");
+    gchar *name;
+    gchar *path;
+
+    if (display == NULL || *display == '\0') {
+        name = g_strdup("i3ipc-glib-socket");
+    } else {
+        name = g_strconcat("i3ipc-glib-socket-", display, NULL);
+        g_strdelimit(name, "/", '_');
+    }
+
+    path = g_build_filename(g_get_user_runtime_dir(), name, NULL);
+    g_free(name);
+
+    return path;
+}
+
+static gchar *read_cache(void) {
+    gchar *cache_path = cache_file_path();
+    gchar *socket_path = NULL;
+
+    if (g_file_get_contents(cache_path, &socket_path, NULL, NULL)) {
+        g_strchomp(socket_path);
+
+        /* a window manager that exited leaves no socket behind */
+        if (!is_socket(socket_path)) {
+            g_clear_pointer(&socket_path, g_free);
+        }
+    }
+
+    g_free(cache_path);
+
+    return socket_path;
+}
+
+/*
+ * Drops @socket_path from the cache after it turned out to be stale, such as
+ * the socket of a window manager that was killed.
+ */
+void i3ipc_discovery_forget(const gchar *socket_path) {
+    gchar *cache_path = cache_file_path();
+    gchar *cached = NULL;
+
+    if (g_file_get_contents(cache_path, &cached, NULL, NULL) &&
+        g_strcmp0(g_strchomp(cached), socket_path) == 0) {
+        unlink(cache_path);
+    }
+
+    g_free(cached);
+    g_free(cache_path);
+}
+
+static void write_cache(const gchar *socket_path) {
+    gchar *cache_path = cache_file_path();
+
+    /* the cache only saves time, so failing to write it is fine */
+    g_file_set_contents(cache_path, socket_path, -1, NULL);
+    g_free(cache_path);
+}
+
+/*
+ * Looks for the socket of a running i3 in $XDG_RUNTIME_DIR/i3. Sockets of
+ * processes that are gone are skipped. When several instances are running
+ * the right one cannot be told apart here, and NULL is returned.
+ */
+static gchar *scan_runtime_dir(void) {
+    const gchar *runtime_dir = g_getenv("XDG_RUNTIME_DIR");
+    const gchar *name;
+    gchar *dir_path;
+    gchar *socket_path = NULL;
+    guint found = 0;
+    GDir *dir;
+
+    if (runtime_dir == NULL || *runtime_dir == '\0') {
+        return NULL;
+    }
+
+    dir_path = g_build_filename(runtime_dir, "i3", NULL);
+    dir = g_dir_open(dir_path, 0, NULL);
+
+    if (dir == NULL) {
+        g_free(dir_path);
+        return NULL;
+    }
+
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        const gchar *pid_str;
+        gchar *end;
+        gchar *path;
+        long pid;
+
+        if (!g_str_has_prefix(name, IPC_SOCKET_PREFIX)) {
+            continue;
+        }
+
+        pid_str = name + strlen(IPC_SOCKET_PREFIX);
+        errno = 0;
+        pid = strtol(pid_str, &end, 10);
+
+        if (errno != 0 || end == pid_str || *end != '\0' || pid <= 0) {
+            continue;
+        }
+
+        if (kill((pid_t)pid, 0) < 0 && errno != EPERM) {
+            continue;
+        }
+
+        path = g_build_filename(dir_path, name, NULL);
+
+        if (!is_socket(path)) {
+            g_free(path);
+            continue;
+        }
+
+        found += 1;
+        g_free(socket_path);
+        socket_path = path;
+    }
+
+    g_dir_close(dir);
+    g_free(dir_path);
+
+    if (found != 1) {
+        g_clear_pointer(&socket_path, g_free);
+    }
+
+    return socket_path;
+}
+
+#ifdef I3IPC_HAVE_XCB
+/*
+ * Reads the I3_SOCKET_PATH property of the root window.
+ */
+static gchar *query_x_server(GError **err) {
+    const char *atomname = "I3_SOCKET_PATH";
+    size_t content_max_words = 256;
+    xcb_connection_t *conn;
+    xcb_screen_t *screen;
+    xcb_intern_atom_cookie_t atom_cookie;
+    xcb_intern_atom_reply_t *atom_reply;
+    xcb_get_property_cookie_t prop_cookie;
+    xcb_get_property_reply_t *prop_reply;
+    gchar *socket_path;
+    int len;
+
+    conn = xcb_connect(NULL, NULL);
+
+    if (xcb_connection_has_error(conn)) {
+        xcb_disconnect(conn);
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                            "Could not find the ipc socket: set I3SOCK or start an X session");
+        return NULL;
+    }
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+
+    atom_cookie = xcb_intern_atom(conn, 0, strlen(atomname), atomname);
+    atom_reply = xcb_intern_atom_reply(conn, atom_cookie, NULL);
+
+    if (atom_reply == NULL) {
+        /* TODO i3ipc custom errors */
+        xcb_disconnect(conn);
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_FAILED, "socket path atom reply is null");
+        return NULL;
+    }
+
+    prop_cookie = xcb_get_property_unchecked(conn, FALSE,               /* _delete */
+                                             screen->root,              /* window */
+                                             atom_reply->atom,          /* property */
+                                             XCB_GET_PROPERTY_TYPE_ANY, /* type */
+                                             0,                         /* long_offset */
+                                             content_max_words          /* long_length */
+    );
+
+    prop_reply = xcb_get_property_reply(conn, prop_cookie, NULL);
+    len = (prop_reply != NULL ? xcb_get_property_value_length(prop_reply) : 0);
+
+    if (len == 0) {
+        /* the window manager has not published its socket yet */
+        free(atom_reply);
+        free(prop_reply);
+        xcb_disconnect(conn);
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                            "socket path property reply is null");
+        return NULL;
+    }
+
+    socket_path = g_strndup((const gchar *)xcb_get_property_value(prop_reply), len);
+
+    free(atom_reply);
+    free(prop_reply);
+    xcb_disconnect(conn);
+
+    return socket_path;
+}
+#endif
+
+/*
+ * Tries, in order: the I3SOCK and SWAYSOCK variables, the path found by the
+ * last discovery, a scan of $XDG_RUNTIME_DIR/i3, and the root window
+ * property. What the last two find is cached for the next process.
+ */
+gchar *i3ipc_discover_socket_path(GError **err) {
+    const gchar *env_path;
+    gchar *socket_path;
+
+    g_return_val_if_fail(err == NULL || *err == NULL, NULL);
+
+    env_path = g_getenv("I3SOCK");
+
+    if (env_path == NULL || *env_path == '\0') {
+        env_path = g_getenv("SWAYSOCK");
+    }
+
+    if (env_path != NULL && *env_path != '\0') {
+        return g_strdup(env_path);
+    }
+
+    if ((socket_path = read_cache()) != NULL) {
+        return socket_path;
+    }
+
+    socket_path = scan_runtime_dir();
+
+#ifdef I3IPC_HAVE_XCB
+    if (socket_path == NULL) {
+        socket_path = query_x_server(err);
+    }
+#else
+    if (socket_path == NULL) {
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                            "Could not find the ipc socket: set I3SOCK to its path");
+    }
+#endif
+
+    if (socket_path != NULL) {
+        write_cache(socket_path);
+    }
+
+    return socket_path;
+}
+
+struct _i3ipcSocketWatch {
+    gchar *socket_path;
+    int fd;
+    guint interval;
+};
+
+i3ipcSocketWatch *i3ipc_socket_watch_new(const gchar *socket_path) {
+    i3ipcSocketWatch *watch = g_new0(i3ipcSocketWatch, 1);
+
+    watch->socket_path = g_strdup(socket_path);
+    watch->fd = -1;
+    watch->interval = WATCH_CHANGE_INTERVAL;
+
+#ifdef __linux__
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (watch->fd >= 0) {
+        watch->interval = WATCH_IDLE_INTERVAL;
+    }
+#endif
+
+    return watch;
+}
+
+void i3ipc_socket_watch_free(i3ipcSocketWatch *watch) {
+    if (watch == NULL) {
+        return;
+    }
+
+    if (watch->fd >= 0) {
+        close(watch->fd);
+    }
+
+    g_free(watch->socket_path);
+    g_free(watch);
+}
+
+#ifdef __linux__
+/*
+ * Watches @path, or the closest parent that exists so the directory itself
+ * is seen when it is created. Adding a watch that exists is cheap, so this
+ * is done before every wait.
+ */
+static void watch_dir(i3ipcSocketWatch *watch, const gchar *path) {
+    gchar *dir = g_strdup(path);
+
+    while (inotify_add_watch(watch->fd, dir, IN_CREATE | IN_MOVED_TO | IN_ATTRIB) < 0 &&
+           errno == ENOENT) {
+        gchar *parent = g_path_get_dirname(dir);
+
+        if (strcmp(parent, dir) == 0) {
+            g_free(parent);
+            break;
+        }
+
+        g_free(dir);
+        dir = parent;
+    }
+
+    g_free(dir);
+}
+
+static void watch_add_dirs(i3ipcSocketWatch *watch) {
+    const gchar *runtime_dir;
+
+    if (watch->socket_path != NULL) {
+        gchar *dir = g_path_get_dirname(watch->socket_path);
+        watch_dir(watch, dir);
+        g_free(dir);
+        return;
+    }
+
+    runtime_dir = g_getenv("XDG_RUNTIME_DIR");
+
+    if (runtime_dir != NULL && *runtime_dir != '\0') {
+        gchar *dir = g_build_filename(runtime_dir, "i3", NULL);
+        watch_dir(watch, dir);
+        g_free(dir);
+    }
+}
+#endif
+
+/*
+ * Blocks until something changes where the socket is expected, or until the
+ * next periodic check is due. Returns FALSE once @deadline, in monotonic time,
+ * has passed. A @deadline of -1 never passes.
+ */
+gboolean i3ipc_socket_watch_wait(i3ipcSocketWatch *watch, gint64 deadline) {
+    gint64 now = g_get_monotonic_time();
+    gint64 timeout = watch->interval;
+
+    if (deadline >= 0) {
+        if (now >= deadline) {
+            return FALSE;
+        }
+
+        timeout = MIN(timeout, (deadline - now + 999) / 1000);
+    }
+
+#ifdef __linux__
+    if (watch->fd >= 0) {
+        GPollFD pfd = {.fd = watch->fd, .events = G_IO_IN};
+        gchar buf[4096];
+
+        watch_add_dirs(watch);
+
+        if (g_poll(&pfd, 1, timeout) > 0) {
+            while (read(watch->fd, buf, sizeof(buf)) > 0) {
+                /* the events only tell that it is time to check again */
+            }
+
+            watch->interval = WATCH_MIN_INTERVAL;
+            return TRUE;
+        }
+
+        /* back off after a change until the idle interval is reached */
+        watch->interval = (watch->interval < WATCH_CHANGE_INTERVAL ? watch->interval * 2
+                                                                    : WATCH_IDLE_INTERVAL);
+        return TRUE;
+    }
+#endif
+
+    /* without inotify, look every now and then */
+    g_usleep(timeout * 1000);
+
+    return TRUE;
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ *
+ */
+
+#ifndef __I3IPC_EVENT_TYPES_PRIVATE_H__
+#define __I3IPC_EVENT_TYPES_PRIVATE_H__
+
+#include "i3ipc-event-types.h"
+
+/*
+ * The events that a connection emits are shared by all of their handlers
+ * instead of being copied for each of them. Such an event lives in a wrapper
+ * that counts its references and that goes back to a small pool with the last
+ * one. The public copy function still makes a deep copy of a shared event,
+ * which is what a handler that keeps it gets, but the public free function
+ * must never be called on one.
+ */
+typedef struct {
+    gint ref_count;
+    GType type;
+
+    union {
+        i3ipcWorkspaceEvent workspace;
+        i3ipcGenericEvent generic;
+        i3ipcWindowEvent window;
+        i3ipcBarconfigUpdateEvent barconfig_update;
+        i3ipcBindingEvent binding;
+    } event;
+} i3ipcSharedEvent;
+
+gpointer i3ipc_shared_event_new(GType type);
+gpointer i3ipc_shared_event_ref(gpointer event);
+void i3ipc_shared_event_unref(gpointer event);
+
+#endif /* __I3IPC_EVENT_TYPES_PRIVATE_H__ */
@@ -20,9 +20,11 @@
 #include "i3ipc-event-types.h"
 
 #include <glib-object.h>
+#include <string.h>
 
 #include "i3ipc-con.h"
 #include "i3ipc-enum-types.h"
+#include "i3ipc-event-types-private.h"
 
 /**
  * i3ipc_workspace_event_copy:
@@ -297,3 +299,118 @@ void i3ipc_binding_event_free(i3ipcBindingEvent *event) {
 
 G_DEFINE_BOXED_TYPE(i3ipcBindingEvent, i3ipc_binding_event, i3ipc_binding_event_copy,
                     i3ipc_binding_event_free);
+
+/* how many released shared events are kept for reuse */
+#define I3IPC_SHARED_EVENT_POOL_SIZE 32
+
+static i3ipcSharedEvent *shared_event_pool[I3IPC_SHARED_EVENT_POOL_SIZE];
+static guint shared_event_pool_size;
+static GMutex shared_event_pool_lock;
+
+static i3ipcSharedEvent *ipc_shared_event_from_event(gpointer event) {
+    return (i3ipcSharedEvent *)((guint8 *)event - G_STRUCT_OFFSET(i3ipcSharedEvent, event));
+}
+
+/*
+ * Frees what a shared event holds, but not the event itself.
+ */
+static void ipc_shared_event_clear(i3ipcSharedEvent *shared) {
+    if (shared->type == I3IPC_TYPE_WORKSPACE_EVENT) {
+        g_free(shared->event.workspace.change);
+        g_clear_object(&shared->event.workspace.current);
+        g_clear_object(&shared->event.workspace.old);
+    } else if (shared->type == I3IPC_TYPE_GENERIC_EVENT) {
+        g_free(shared->event.generic.change);
+    } else if (shared->type == I3IPC_TYPE_WINDOW_EVENT) {
+        g_free(shared->event.window.change);
+        g_clear_object(&shared->event.window.container);
+    } else if (shared->type == I3IPC_TYPE_BARCONFIG_UPDATE_EVENT) {
+        g_free(shared->event.barconfig_update.id);
+        g_free(shared->event.barconfig_update.hidden_state);
+        g_free(shared->event.barconfig_update.mode);
+    } else if (shared->type == I3IPC_TYPE_BINDING_EVENT) {
+        g_free(shared->event.binding.change);
+        i3ipc_binding_info_free(shared->event.binding.binding);
+    } else {
+        g_assert_not_reached();
+    }
+}
+
+/*
+ * i3ipc_shared_event_new:
+ * @type: the boxed type of the event
+ *
+ * Returns: an empty shared event of @type with one reference
+ */
+gpointer i3ipc_shared_event_new(GType type) {
+    i3ipcSharedEvent *shared = NULL;
+
+    g_mutex_lock(&shared_event_pool_lock);
+
+    if (shared_event_pool_size > 0) {
+        shared = shared_event_pool[--shared_event_pool_size];
+    }
+
+    g_mutex_unlock(&shared_event_pool_lock);
+
+    if (shared == NULL) {
+        shared = g_slice_new0(i3ipcSharedEvent);
+    } else {
+        memset(shared, 0, sizeof(i3ipcSharedEvent));
+    }
+
+    shared->ref_count = 1;
+    shared->type = type;
+
+    return &shared->event;
+}
+
+/*
+ * i3ipc_shared_event_ref:
+ * @event: an event from i3ipc_shared_event_new()
+ *
+ * Returns: @event, with one more reference
+ */
+gpointer i3ipc_shared_event_ref(gpointer event) {
+    g_return_val_if_fail(event != NULL, NULL);
+
+    g_atomic_int_inc(&ipc_shared_event_from_event(event)->ref_count);
+
+    return event;
+}
+
+/*
+ * i3ipc_shared_event_unref:
+ * @event: (allow-none): an event from i3ipc_shared_event_new()
+ *
+ * Drops a reference on @event, and frees what it holds and puts it back in the
+ * pool with the last one.
+ */
+void i3ipc_shared_event_unref(gpointer event) {
+    i3ipcSharedEvent *shared;
+
+    if (!event) {
+        return;
+    }
+
+    shared = ipc_shared_event_from_event(event);
+
+    if (!g_atomic_int_dec_and_test(&shared->ref_count)) {
+        return;
+    }
+
+    ipc_shared_event_clear(shared);
+
+    g_mutex_lock(&shared_event_pool_lock);
+
+    if (shared_event_pool_size < I3IPC_SHARED_EVENT_POOL_SIZE) {
+        shared_event_pool[shared_event_pool_size++] = shared;
+        shared = NULL;
+    }
+
+    g_mutex_unlock(&shared_event_pool_lock);
+
+    if (shared != NULL) {
+        g_slice_free(i3ipcSharedEvent, shared);
+    }
+}
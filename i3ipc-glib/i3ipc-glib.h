@@ -3,8 +3,11 @@
 
 #include <i3ipc-glib/i3ipc-con.h>
 #include <i3ipc-glib/i3ipc-connection.h>
+#include <i3ipc-glib/i3ipc-connection-manager.h>
+#include <i3ipc-glib/i3ipc-connection-pool.h>
 #include <i3ipc-glib/i3ipc-enum-types.h>
 #include <i3ipc-glib/i3ipc-event-types.h>
 #include <i3ipc-glib/i3ipc-reply-types.h>
+#include <i3ipc-glib/i3ipc-transport.h>
 
 #endif /* __I3IPC_GLIB_H__ */
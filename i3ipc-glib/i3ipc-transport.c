@@ -0,0 +1,356 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ */
+
+#include "i3ipc-transport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+G_DEFINE_ABSTRACT_TYPE(i3ipcTransport, i3ipc_transport, G_TYPE_OBJECT);
+
+static void i3ipc_transport_class_init(i3ipcTransportClass *klass) {
+}
+
+static void i3ipc_transport_init(i3ipcTransport *self) {
+}
+
+/**
+ * i3ipc_transport_open:
+ * @transport: An #i3ipcTransport
+ * @err: (allow-none): return location for a GError, or NULL
+ *
+ * Opens a new stream socket to the ipc. An #i3ipcConnection opens one for
+ * its commands and one for its events.
+ *
+ * Returns: the file descriptor of the socket, owned by the caller, or -1 on
+ * failure
+ */
+gint i3ipc_transport_open(i3ipcTransport *transport, GError **err) {
+    g_return_val_if_fail(I3IPC_IS_TRANSPORT(transport), -1);
+    g_return_val_if_fail(err == NULL || *err == NULL, -1);
+
+    return I3IPC_TRANSPORT_GET_CLASS(transport)->open(transport, err);
+}
+
+enum {
+    UNIX_PROP_0,
+
+    UNIX_PROP_SOCKET_PATH,
+
+    UNIX_N_PROPERTIES
+};
+
+static GParamSpec *unix_properties[UNIX_N_PROPERTIES] = {
+    NULL,
+};
+
+struct _i3ipcUnixTransportPrivate {
+    gchar *socket_path;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE(i3ipcUnixTransport, i3ipc_unix_transport, I3IPC_TYPE_TRANSPORT);
+
+static void i3ipc_unix_transport_set_property(GObject *object, guint property_id,
+                                              const GValue *value, GParamSpec *pspec) {
+    i3ipcUnixTransport *self = I3IPC_UNIX_TRANSPORT(object);
+
+    switch (property_id) {
+    case UNIX_PROP_SOCKET_PATH:
+        g_free(self->priv->socket_path);
+        self->priv->socket_path = g_value_dup_string(value);
+        break;
+
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void i3ipc_unix_transport_get_property(GObject *object, guint property_id, GValue *value,
+                                              GParamSpec *pspec) {
+    i3ipcUnixTransport *self = I3IPC_UNIX_TRANSPORT(object);
+
+    switch (property_id) {
+    case UNIX_PROP_SOCKET_PATH:
+        g_value_set_string(value, self->priv->socket_path);
+        break;
+
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void i3ipc_unix_transport_finalize(GObject *gobject) {
+    i3ipcUnixTransport *self = I3IPC_UNIX_TRANSPORT(gobject);
+
+    g_free(self->priv->socket_path);
+
+    G_OBJECT_CLASS(i3ipc_unix_transport_parent_class)->finalize(gobject);
+}
+
+static gint i3ipc_unix_transport_open(i3ipcTransport *transport, GError **err) {
+    i3ipcUnixTransport *self = I3IPC_UNIX_TRANSPORT(transport);
+    GError *tmp_error = NULL;
+
+    if (self->priv->socket_path == NULL) {
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                            "No socket path was given to the transport");
+        return -1;
+    }
+
+    int sockfd = socket(AF_LOCAL, SOCK_STREAM, 0);
+
+    if (sockfd == -1) {
+        tmp_error = g_error_new(G_IO_ERROR, g_io_error_from_errno(errno),
+                                "Could not create socket (%s)\n", strerror(errno));
+        g_propagate_error(err, tmp_error);
+        return -1;
+    }
+
+    (void)fcntl(sockfd, F_SETFD, FD_CLOEXEC);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_LOCAL;
+    strncpy(addr.sun_path, self->priv->socket_path, sizeof(addr.sun_path) - 1);
+
+    if (connect(sockfd, (const struct sockaddr *)&addr, sizeof(struct sockaddr_un)) < 0) {
+        tmp_error = g_error_new(G_IO_ERROR, g_io_error_from_errno(errno),
+                                "Could not connect to i3 (%s)\n", strerror(errno));
+        g_propagate_error(err, tmp_error);
+        close(sockfd);
+        return -1;
+    }
+
+    return sockfd;
+}
+
+static void i3ipc_unix_transport_class_init(i3ipcUnixTransportClass *klass) {
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    i3ipcTransportClass *transport_class = I3IPC_TRANSPORT_CLASS(klass);
+
+    gobject_class->set_property = i3ipc_unix_transport_set_property;
+    gobject_class->get_property = i3ipc_unix_transport_get_property;
+    gobject_class->finalize = i3ipc_unix_transport_finalize;
+    transport_class->open = i3ipc_unix_transport_open;
+
+    unix_properties[UNIX_PROP_SOCKET_PATH] =
+        g_param_spec_string("socket-path", "Transport socket path",
+                            "The path of the unix socket to connect to", NULL, /* default */
+                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    g_object_class_install_properties(gobject_class, UNIX_N_PROPERTIES, unix_properties);
+}
+
+static void i3ipc_unix_transport_init(i3ipcUnixTransport *self) {
+    self->priv = i3ipc_unix_transport_get_instance_private(self);
+}
+
+/**
+ * i3ipc_unix_transport_new:
+ * @socket_path: the path of the unix socket of the ipc
+ *
+ * Creates a transport that connects to the unix socket at @socket_path.
+ *
+ * Returns: (transfer full): a new #i3ipcUnixTransport
+ */
+i3ipcTransport *i3ipc_unix_transport_new(const gchar *socket_path) {
+    return g_object_new(I3IPC_TYPE_UNIX_TRANSPORT, "socket-path", socket_path, NULL);
+}
+
+/**
+ * i3ipc_unix_transport_get_socket_path:
+ * @self: An #i3ipcUnixTransport
+ *
+ * Returns: (transfer none): the path of the unix socket the transport connects to
+ */
+const gchar *i3ipc_unix_transport_get_socket_path(i3ipcUnixTransport *self) {
+    g_return_val_if_fail(I3IPC_IS_UNIX_TRANSPORT(self), NULL);
+
+    return self->priv->socket_path;
+}
+
+enum { PEER_OPENED, SOCKETPAIR_LAST_SIGNAL };
+
+static guint socketpair_signals[SOCKETPAIR_LAST_SIGNAL] = {0};
+
+struct _i3ipcSocketpairTransportPrivate {
+    GArray *peers;
+    GMutex lock;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE(i3ipcSocketpairTransport, i3ipc_socketpair_transport,
+                           I3IPC_TYPE_TRANSPORT);
+
+static void i3ipc_socketpair_transport_finalize(GObject *gobject) {
+    i3ipcSocketpairTransport *self = I3IPC_SOCKETPAIR_TRANSPORT(gobject);
+
+    for (guint i = 0; i < self->priv->peers->len; i += 1) {
+        if (g_array_index(self->priv->peers, gint, i) >= 0) {
+            close(g_array_index(self->priv->peers, gint, i));
+        }
+    }
+
+    g_array_unref(self->priv->peers);
+    g_mutex_clear(&self->priv->lock);
+
+    G_OBJECT_CLASS(i3ipc_socketpair_transport_parent_class)->finalize(gobject);
+}
+
+/*
+ * Closes the peers whose socket was closed by the connection, so a connection
+ * that reconnects does not leave a socketpair behind every time. Their index
+ * stays taken. Called with the lock held.
+ */
+static void ipc_socketpair_close_hung_up(i3ipcSocketpairTransport *self) {
+    for (guint i = 0; i < self->priv->peers->len; i += 1) {
+        gint *fd = &g_array_index(self->priv->peers, gint, i);
+        struct pollfd pfd = {.fd = *fd, .events = 0};
+
+        if (*fd >= 0 && poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLNVAL))) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+static gint i3ipc_socketpair_transport_open(i3ipcTransport *transport, GError **err) {
+    i3ipcSocketpairTransport *self = I3IPC_SOCKETPAIR_TRANSPORT(transport);
+    int fds[2];
+    guint index;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "Could not create socketpair (%s)", strerror(errno));
+        return -1;
+    }
+
+    (void)fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    (void)fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    g_mutex_lock(&self->priv->lock);
+    ipc_socketpair_close_hung_up(self);
+    g_array_append_val(self->priv->peers, fds[1]);
+    index = self->priv->peers->len - 1;
+    g_mutex_unlock(&self->priv->lock);
+
+    g_signal_emit(self, socketpair_signals[PEER_OPENED], 0, index, fds[1]);
+
+    return fds[0];
+}
+
+static void i3ipc_socketpair_transport_class_init(i3ipcSocketpairTransportClass *klass) {
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    i3ipcTransportClass *transport_class = I3IPC_TRANSPORT_CLASS(klass);
+
+    gobject_class->finalize = i3ipc_socketpair_transport_finalize;
+    transport_class->open = i3ipc_socketpair_transport_open;
+
+    /**
+     * i3ipcSocketpairTransport::peer-opened:
+     * @self: the #i3ipcSocketpairTransport on which the signal was emitted
+     * @index: the index of the new peer
+     * @fd: the file descriptor of the peer, owned by the transport
+     *
+     * Emitted when a connection opens a socket. The peer end plays the part
+     * of the window manager: it receives the messages of the connection and
+     * whatever is written to it is read by the connection.
+     */
+    socketpair_signals[PEER_OPENED] =
+        g_signal_new("peer-opened",                   /* signal_name */
+                     I3IPC_TYPE_SOCKETPAIR_TRANSPORT, /* itype */
+                     G_SIGNAL_RUN_FIRST,              /* signal_flags */
+                     0,                               /* class_offset */
+                     NULL,                            /* accumulator */
+                     NULL,                            /* accu_data */
+                     g_cclosure_marshal_generic,      /* c_marshaller */
+                     G_TYPE_NONE,                     /* return_type */
+                     2, G_TYPE_UINT, G_TYPE_INT);     /* n_params */
+}
+
+static void i3ipc_socketpair_transport_init(i3ipcSocketpairTransport *self) {
+    self->priv = i3ipc_socketpair_transport_get_instance_private(self);
+    self->priv->peers = g_array_new(FALSE, FALSE, sizeof(gint));
+    g_mutex_init(&self->priv->lock);
+}
+
+/**
+ * i3ipc_socketpair_transport_new:
+ *
+ * Creates a transport that connects to the other end of a socketpair for
+ * every socket that is opened.
+ *
+ * Returns: (transfer full): a new #i3ipcSocketpairTransport
+ */
+i3ipcTransport *i3ipc_socketpair_transport_new(void) {
+    return g_object_new(I3IPC_TYPE_SOCKETPAIR_TRANSPORT, NULL);
+}
+
+/**
+ * i3ipc_socketpair_transport_get_n_peers:
+ * @self: An #i3ipcSocketpairTransport
+ *
+ * Returns: the number of sockets that were opened through the transport
+ */
+guint i3ipc_socketpair_transport_get_n_peers(i3ipcSocketpairTransport *self) {
+    guint n_peers;
+
+    g_return_val_if_fail(I3IPC_IS_SOCKETPAIR_TRANSPORT(self), 0);
+
+    g_mutex_lock(&self->priv->lock);
+    n_peers = self->priv->peers->len;
+    g_mutex_unlock(&self->priv->lock);
+
+    return n_peers;
+}
+
+/**
+ * i3ipc_socketpair_transport_get_peer_fd:
+ * @self: An #i3ipcSocketpairTransport
+ * @index: the index of the peer, in the order the sockets were opened
+ *
+ * Gets the peer end of a socket that was opened through the transport. It is
+ * owned by the transport and closed when the transport is finalized, or when
+ * another socket is opened after the connection closed its end.
+ *
+ * Returns: the file descriptor of the peer, or -1 if there is no such peer or
+ * it was closed
+ */
+gint i3ipc_socketpair_transport_get_peer_fd(i3ipcSocketpairTransport *self, guint index) {
+    gint fd = -1;
+
+    g_return_val_if_fail(I3IPC_IS_SOCKETPAIR_TRANSPORT(self), -1);
+
+    g_mutex_lock(&self->priv->lock);
+
+    if (index < self->priv->peers->len) {
+        fd = g_array_index(self->priv->peers, gint, index);
+    }
+
+    g_mutex_unlock(&self->priv->lock);
+
+    return fd;
+}
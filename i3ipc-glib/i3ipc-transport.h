@@ -0,0 +1,127 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ *
+ */
+
+#ifndef __I3IPC_TRANSPORT_H__
+#define __I3IPC_TRANSPORT_H__
+
+#include <glib-object.h>
+
+/**
+ * SECTION: i3ipc-transport
+ * @short_description: The way an #i3ipcConnection reaches the ipc.
+ *
+ * A transport opens the stream sockets a connection talks to the ipc over.
+ * #i3ipcUnixTransport connects to the unix socket of i3 and is used when no
+ * transport is given. #i3ipcSocketpairTransport connects to the other end of
+ * a socketpair in the same process, so tests and benchmarks can act as the
+ * window manager without one running.
+ *
+ * Other transports subclass #i3ipcTransport and implement the open virtual
+ * function.
+ */
+
+#define I3IPC_TYPE_TRANSPORT (i3ipc_transport_get_type())
+#define I3IPC_TRANSPORT(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), I3IPC_TYPE_TRANSPORT, i3ipcTransport))
+#define I3IPC_IS_TRANSPORT(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), I3IPC_TYPE_TRANSPORT))
+#define I3IPC_TRANSPORT_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST((klass), I3IPC_TYPE_TRANSPORT, i3ipcTransportClass))
+#define I3IPC_IS_TRANSPORT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), I3IPC_TYPE_TRANSPORT))
+#define I3IPC_TRANSPORT_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS((obj), I3IPC_TYPE_TRANSPORT, i3ipcTransportClass))
+
+typedef struct _i3ipcTransport i3ipcTransport;
+typedef struct _i3ipcTransportClass i3ipcTransportClass;
+
+struct _i3ipcTransport {
+    GObject parent_instance;
+};
+
+/**
+ * i3ipcTransportClass:
+ * @parent_class: The parent class
+ * @open: Opens a new stream socket to the ipc and returns its file
+ * descriptor, which the caller owns. Returns -1 and sets the error on failure.
+ */
+struct _i3ipcTransportClass {
+    GObjectClass parent_class;
+
+    gint (*open)(i3ipcTransport *transport, GError **err);
+};
+
+GType i3ipc_transport_get_type(void);
+
+gint i3ipc_transport_open(i3ipcTransport *transport, GError **err);
+
+#define I3IPC_TYPE_UNIX_TRANSPORT (i3ipc_unix_transport_get_type())
+#define I3IPC_UNIX_TRANSPORT(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), I3IPC_TYPE_UNIX_TRANSPORT, i3ipcUnixTransport))
+#define I3IPC_IS_UNIX_TRANSPORT(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), I3IPC_TYPE_UNIX_TRANSPORT))
+
+typedef struct _i3ipcUnixTransport i3ipcUnixTransport;
+typedef struct _i3ipcUnixTransportClass i3ipcUnixTransportClass;
+typedef struct _i3ipcUnixTransportPrivate i3ipcUnixTransportPrivate;
+
+struct _i3ipcUnixTransport {
+    i3ipcTransport parent_instance;
+
+    i3ipcUnixTransportPrivate *priv;
+};
+
+struct _i3ipcUnixTransportClass {
+    i3ipcTransportClass parent_class;
+};
+
+GType i3ipc_unix_transport_get_type(void);
+
+i3ipcTransport *i3ipc_unix_transport_new(const gchar *socket_path);
+
+const gchar *i3ipc_unix_transport_get_socket_path(i3ipcUnixTransport *self);
+
+#define I3IPC_TYPE_SOCKETPAIR_TRANSPORT (i3ipc_socketpair_transport_get_type())
+#define I3IPC_SOCKETPAIR_TRANSPORT(obj)                                     \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), I3IPC_TYPE_SOCKETPAIR_TRANSPORT, \
+                                i3ipcSocketpairTransport))
+#define I3IPC_IS_SOCKETPAIR_TRANSPORT(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE((obj), I3IPC_TYPE_SOCKETPAIR_TRANSPORT))
+
+typedef struct _i3ipcSocketpairTransport i3ipcSocketpairTransport;
+typedef struct _i3ipcSocketpairTransportClass i3ipcSocketpairTransportClass;
+typedef struct _i3ipcSocketpairTransportPrivate i3ipcSocketpairTransportPrivate;
+
+struct _i3ipcSocketpairTransport {
+    i3ipcTransport parent_instance;
+
+    i3ipcSocketpairTransportPrivate *priv;
+};
+
+struct _i3ipcSocketpairTransportClass {
+    i3ipcTransportClass parent_class;
+};
+
+GType i3ipc_socketpair_transport_get_type(void);
+
+i3ipcTransport *i3ipc_socketpair_transport_new(void);
+
+guint i3ipc_socketpair_transport_get_n_peers(i3ipcSocketpairTransport *self);
+
+gint i3ipc_socketpair_transport_get_peer_fd(i3ipcSocketpairTransport *self, guint index);
+
+#endif /* __I3IPC_TRANSPORT_H__ */
@@ -0,0 +1,46 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ *
+ */
+
+#ifndef __I3IPC_URING_PRIVATE_H__
+#define __I3IPC_URING_PRIVATE_H__
+
+#include <glib.h>
+#include <sys/socket.h>
+
+/*
+ * An io_uring that receives the events of a connection with a multishot
+ * receive and runs the blocking sends and receives of the command socket.
+ * Only compiled in with the io-uring build option.
+ */
+typedef struct _i3ipcUring i3ipcUring;
+
+i3ipcUring *i3ipc_uring_new(int sub_fd, GByteArray *sub_buf);
+
+void i3ipc_uring_free(i3ipcUring *ring);
+
+int i3ipc_uring_get_fd(i3ipcUring *ring);
+
+GIOStatus i3ipc_uring_fill_events(i3ipcUring *ring, GError **err);
+
+gssize i3ipc_uring_sendmsg(i3ipcUring *ring, int fd, const struct msghdr *msg, int flags);
+
+gssize i3ipc_uring_recv(i3ipcUring *ring, int fd, gpointer buf, gsize len, int flags);
+
+#endif /* __I3IPC_URING_PRIVATE_H__ */
@@ -0,0 +1,319 @@
+/*
+ * This file is part of i3-ipc.
+ *
+ * i3-ipc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * i3-ipc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with i3-ipc.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright © 2014, Tony Crisci
+ */
+
+#include "i3ipc-uring-private.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <liburing.h>
+#include <string.h>
+
+#define URING_ENTRIES 64
+
+/* the buffers the kernel picks from for the multishot receive */
+#define URING_BUF_GROUP 0
+#define URING_BUF_COUNT 16
+#define URING_BUF_SIZE 4096
+
+/* the low byte of the user data of a request tells what it is */
+enum { URING_OP_EVENTS = 1, URING_OP_BLOCKING };
+
+struct _i3ipcUring {
+    struct io_uring ring;
+    struct io_uring_buf_ring *buf_ring;
+    guint8 *bufs;
+
+    int sub_fd;
+    GByteArray *sub_buf;
+    gboolean armed;
+    gboolean eof;
+    int sub_errno;
+
+    /* the one blocking request that can be in flight */
+    guint64 seq;
+    guint64 op_tag;
+    gboolean op_done;
+    int op_result;
+};
+
+static struct io_uring_sqe *uring_get_sqe(i3ipcUring *self) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&self->ring);
+
+    if (sqe == NULL) {
+        /* the submission queue is full, make room */
+        io_uring_submit(&self->ring);
+        sqe = io_uring_get_sqe(&self->ring);
+    }
+
+    return sqe;
+}
+
+/*
+ * Queues the multishot receive on the subscription socket. It is submitted
+ * together with whatever is submitted next.
+ */
+static void uring_arm_events(i3ipcUring *self) {
+    struct io_uring_sqe *sqe = uring_get_sqe(self);
+
+    io_uring_prep_recv_multishot(sqe, self->sub_fd, NULL, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    io_uring_sqe_set_data64(sqe, URING_OP_EVENTS);
+
+    self->armed = TRUE;
+}
+
+static void uring_handle_events_cqe(i3ipcUring *self, struct io_uring_cqe *cqe) {
+    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+        guint id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        guint8 *buf = self->bufs + id * URING_BUF_SIZE;
+
+        if (self->sub_buf != NULL) {
+            g_byte_array_append(self->sub_buf, buf, cqe->res);
+        }
+
+        /* hand the buffer back to the kernel right away */
+        io_uring_buf_ring_add(self->buf_ring, buf, URING_BUF_SIZE, id,
+                              io_uring_buf_ring_mask(URING_BUF_COUNT), 0);
+        io_uring_buf_ring_advance(self->buf_ring, 1);
+    } else if (cqe->res == 0) {
+        self->eof = TRUE;
+    } else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+        self->sub_errno = -cqe->res;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        self->armed = FALSE;
+    }
+}
+
+/*
+ * Handles every completion that is ready without entering the kernel, and
+ * re-arms the multishot receive when the kernel terminated it.
+ */
+static void uring_reap(i3ipcUring *self) {
+    struct io_uring_cqe *cqe;
+    unsigned head;
+    unsigned count = 0;
+
+    io_uring_for_each_cqe(&self->ring, head, cqe) {
+        guint64 tag = io_uring_cqe_get_data64(cqe);
+
+        if (tag == URING_OP_EVENTS) {
+            uring_handle_events_cqe(self, cqe);
+        } else if (tag == self->op_tag) {
+            self->op_result = cqe->res;
+            self->op_done = TRUE;
+        }
+
+        count += 1;
+    }
+
+    io_uring_cq_advance(&self->ring, count);
+
+    if (!self->armed && !self->eof && self->sub_errno == 0 && self->sub_buf != NULL) {
+        uring_arm_events(self);
+        io_uring_submit(&self->ring);
+    }
+}
+
+/*
+ * Submits @sqe along with anything else that is queued and waits for its
+ * completion. Returns the result like the matching syscall would.
+ */
+static gssize uring_run(i3ipcUring *self, struct io_uring_sqe *sqe) {
+    self->seq += 1;
+    self->op_tag = (self->seq << 8) | URING_OP_BLOCKING;
+    self->op_done = FALSE;
+    io_uring_sqe_set_data64(sqe, self->op_tag);
+
+    while (!self->op_done) {
+        int ret = io_uring_submit_and_wait(&self->ring, 1);
+
+        if (ret < 0 && ret != -EINTR) {
+            /* a late completion no longer matches the tag */
+            self->op_tag = 0;
+            errno = -ret;
+            return -1;
+        }
+
+        uring_reap(self);
+    }
+
+    self->op_tag = 0;
+
+    if (self->op_result < 0) {
+        errno = -self->op_result;
+        return -1;
+    }
+
+    return self->op_result;
+}
+
+/*
+ * Whether the kernel has everything that is used here. Multishot receives
+ * cannot be probed for, but came with the same release as IORING_OP_SEND_ZC.
+ */
+static gboolean uring_probe(i3ipcUring *self) {
+    struct io_uring_probe *probe = io_uring_get_probe_ring(&self->ring);
+    gboolean retval;
+
+    if (probe == NULL) {
+        return FALSE;
+    }
+
+    retval = (io_uring_opcode_supported(probe, IORING_OP_SENDMSG) &&
+              io_uring_opcode_supported(probe, IORING_OP_RECV) &&
+              io_uring_opcode_supported(probe, IORING_OP_SEND_ZC));
+
+    io_uring_free_probe(probe);
+
+    return retval;
+}
+
+/*
+ * Sets up a ring that appends everything received on @sub_fd to @sub_buf.
+ * Returns NULL when io_uring is not available, in which case the plain
+ * syscalls have to be used.
+ */
+i3ipcUring *i3ipc_uring_new(int sub_fd, GByteArray *sub_buf) {
+    i3ipcUring *self = g_new0(i3ipcUring, 1);
+    int ret;
+
+    if (io_uring_queue_init(URING_ENTRIES, &self->ring, 0) < 0) {
+        g_free(self);
+        return NULL;
+    }
+
+    if (!uring_probe(self)) {
+        io_uring_queue_exit(&self->ring);
+        g_free(self);
+        return NULL;
+    }
+
+    self->buf_ring =
+        io_uring_setup_buf_ring(&self->ring, URING_BUF_COUNT, URING_BUF_GROUP, 0, &ret);
+
+    if (self->buf_ring == NULL) {
+        io_uring_queue_exit(&self->ring);
+        g_free(self);
+        return NULL;
+    }
+
+    self->bufs = g_malloc(URING_BUF_COUNT * URING_BUF_SIZE);
+
+    for (guint i = 0; i < URING_BUF_COUNT; i += 1) {
+        io_uring_buf_ring_add(self->buf_ring, self->bufs + i * URING_BUF_SIZE, URING_BUF_SIZE, i,
+                              io_uring_buf_ring_mask(URING_BUF_COUNT), i);
+    }
+
+    io_uring_buf_ring_advance(self->buf_ring, URING_BUF_COUNT);
+
+    self->sub_fd = sub_fd;
+    self->sub_buf = sub_buf;
+
+    uring_arm_events(self);
+
+    if (io_uring_submit(&self->ring) < 0) {
+        self->armed = FALSE;
+        i3ipc_uring_free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void i3ipc_uring_free(i3ipcUring *self) {
+    if (self == NULL) {
+        return;
+    }
+
+    /* the kernel must be done with the buffers before they are freed */
+    self->sub_buf = NULL;
+
+    if (self->armed) {
+        struct io_uring_sqe *sqe = uring_get_sqe(self);
+
+        io_uring_prep_cancel64(sqe, URING_OP_EVENTS, 0);
+        io_uring_sqe_set_data64(sqe, 0);
+
+        while (self->armed && io_uring_submit_and_wait(&self->ring, 1) >= 0) {
+            uring_reap(self);
+        }
+    }
+
+    io_uring_free_buf_ring(&self->ring, self->buf_ring, URING_BUF_COUNT, URING_BUF_GROUP);
+    io_uring_queue_exit(&self->ring);
+    g_free(self->bufs);
+    g_free(self);
+}
+
+/*
+ * The fd that becomes readable when there are completions to reap.
+ */
+int i3ipc_uring_get_fd(i3ipcUring *self) {
+    return self->ring.ring_fd;
+}
+
+/*
+ * Appends the data the multishot receive got on the subscription socket to the
+ * buffer without blocking. Returns G_IO_STATUS_AGAIN when nothing was received, and
+ * G_IO_STATUS_EOF only once the buffered data was returned.
+ */
+GIOStatus i3ipc_uring_fill_events(i3ipcUring *self, GError **err) {
+    guint len = self->sub_buf->len;
+
+    uring_reap(self);
+
+    if (self->sub_buf->len > len) {
+        return G_IO_STATUS_NORMAL;
+    }
+
+    if (self->sub_errno != 0) {
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(self->sub_errno),
+                    "Could not read from i3 (%s)", strerror(self->sub_errno));
+        return G_IO_STATUS_ERROR;
+    }
+
+    return (self->eof ? G_IO_STATUS_EOF : G_IO_STATUS_AGAIN);
+}
+
+/*
+ * Works like sendmsg(2), with the completions of the multishot receive
+ * handled on the way.
+ */
+gssize i3ipc_uring_sendmsg(i3ipcUring *self, int fd, const struct msghdr *msg, int flags) {
+    struct io_uring_sqe *sqe = uring_get_sqe(self);
+
+    io_uring_prep_sendmsg(sqe, fd, msg, flags);
+
+    return uring_run(self, sqe);
+}
+
+/*
+ * Works like recv(2), so a blocking receive costs one io_uring_enter instead
+ * of a poll and a read.
+ */
+gssize i3ipc_uring_recv(i3ipcUring *self, int fd, gpointer buf, gsize len, int flags) {
+    struct io_uring_sqe *sqe = uring_get_sqe(self);
+
+    io_uring_prep_recv(sqe, fd, buf, len, flags);
+
+    return uring_run(self, sqe);
+}
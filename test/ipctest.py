@@ -3,7 +3,6 @@ import pytest
 from gi.repository import i3ipc
 import math
 from random import random
-from time import sleep
 
 
 class IpcTest:
@@ -14,21 +13,12 @@ class IpcTest:
     def i3(self):
         process = Popen(['/usr/bin/i3', '-c', 'test/i3.config'])
         # wait for i3 to start up
-        tries = 0
-
-        while True:
-            try:
-                IpcTest.i3_conn = i3ipc.Connection.new()
-                break
-            except Exception:
-                tries += 1
-
-                if tries > 500:
-                    raise Exception('could not start i3')
-                sleep(0.01)
+        IpcTest.i3_conn = i3ipc.Connection.new_wait(None, 5000)
 
         yield IpcTest.i3_conn
         process.kill()
+        # a zombie would still look like a running i3 to the socket discovery
+        process.wait()
         IpcTest.i3_conn = None
 
     def open_window(self):
@@ -0,0 +1,68 @@
+from ipctest import IpcTest
+from gi.repository import GLib, i3ipc
+
+
+class TestAsync(IpcTest):
+    def test_get_tree_async(self, i3):
+        loop = GLib.MainLoop()
+        results = []
+
+        def on_tree(conn, result):
+            results.append(conn.get_tree_finish(result))
+            loop.quit()
+
+        i3.get_tree_async(None, on_tree)
+        loop.run()
+
+        assert len(results) == 1
+        assert results[0].props.type == 'root'
+
+    def test_replies_in_order(self, i3):
+        loop = GLib.MainLoop()
+        results = []
+
+        def on_workspaces(conn, result):
+            results.append(conn.get_workspaces_finish(result))
+
+        def on_command(conn, result):
+            results.append(conn.command_finish(result))
+            loop.quit()
+
+        i3.get_workspaces_async(None, on_workspaces)
+        i3.command_async('nop', None, on_command)
+        loop.run()
+
+        assert len(results) == 2
+        assert isinstance(results[0], list)
+        assert results[1][0].success
+
+    def test_sync_after_async(self, i3):
+        results = []
+
+        def on_marks(conn, result):
+            results.append(conn.get_marks_finish(result))
+
+        i3.get_marks_async(None, on_marks)
+        # the sync call reads the pending reply first
+        assert i3.get_version().major >= 4
+
+        context = GLib.MainContext.default()
+        while not results:
+            context.iteration(True)
+
+        assert isinstance(results[0], list)
+
+    def test_new_async(self, i3):
+        loop = GLib.MainLoop()
+        results = []
+
+        def on_connected(source, result):
+            results.append(i3ipc.Connection.new_finish(result))
+            loop.quit()
+
+        i3ipc.Connection.new_async(i3.get_property('socket-path'), None, on_connected)
+        loop.run()
+
+        assert len(results) == 1
+        assert results[0].get_property('connected')
+        assert results[0].get_version().major >= 4
@@ -0,0 +1,33 @@
+from ipctest import IpcTest
+from gi.repository import i3ipc, GLib
+
+
+class TestCoalesce(IpcTest):
+    def test_coalesce(self, i3):
+        first = self.fresh_workspace()
+        self.open_window()
+        second = self.fresh_workspace()
+        self.open_window()
+
+        loop = GLib.MainLoop()
+        events = []
+
+        def on_workspace(conn, e):
+            events.append(e.current.props.name)
+            if len(events) == 2:
+                loop.quit()
+
+        i3.set_coalesce(i3ipc.Event.WORKSPACE, 'focus', 200)
+        handler = i3.connect('workspace::focus', on_workspace)
+        i3.command('workspace %s; workspace %s; workspace %s' % (first, second, first))
+        GLib.timeout_add(2000, loop.quit)
+        loop.run()
+        i3.disconnect(handler)
+
+        # the second focus of the first workspace replaced the first one, and
+        # is delivered last since it happened last
+        assert events == [second, first]
+        assert i3.get_coalesced(i3ipc.Event.WORKSPACE, 'focus') == 1
+
+        i3.set_coalesce(i3ipc.Event.WORKSPACE, 'focus', 0)
+        assert i3.get_coalesced(i3ipc.Event.WORKSPACE, 'focus') == 0
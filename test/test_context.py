@@ -0,0 +1,32 @@
+from ipctest import IpcTest
+from gi.repository import GLib
+from threading import Thread
+
+
+class TestContext(IpcTest):
+    def test_events_on_worker_context(self, i3):
+        context = GLib.MainContext.new()
+        loop = GLib.MainLoop.new(context, False)
+        events = []
+
+        def on_workspace(conn, e):
+            events.append(e)
+            loop.quit()
+
+        i3.on('workspace::focus', on_workspace)
+        i3.attach(context)
+
+        thread = Thread(target=loop.run)
+        thread.start()
+        i3.command('workspace %s-context' % self.fresh_workspace())
+        thread.join(2)
+
+        assert not thread.is_alive()
+        assert len(events) == 1
+
+        i3.attach(None)
+
+    def test_event_priority(self, i3):
+        i3.props.event_priority = GLib.PRIORITY_LOW
+        assert i3.props.event_priority == GLib.PRIORITY_LOW
+        i3.props.event_priority = GLib.PRIORITY_DEFAULT
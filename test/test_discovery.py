@@ -0,0 +1,26 @@
+from ipctest import IpcTest
+from gi.repository import GLib, i3ipc
+import os
+
+
+class TestDiscovery(IpcTest):
+    def test_i3sock(self, i3, monkeypatch):
+        socket_path = i3.get_property('socket-path')
+        monkeypatch.setenv('I3SOCK', socket_path)
+
+        conn = i3ipc.Connection.new(None)
+        assert conn.get_property('socket-path') == socket_path
+
+    def test_cache(self, i3, monkeypatch):
+        monkeypatch.delenv('I3SOCK', raising=False)
+        monkeypatch.delenv('SWAYSOCK', raising=False)
+
+        conn = i3ipc.Connection.new(None)
+        socket_path = conn.get_property('socket-path')
+        assert socket_path == i3.get_property('socket-path')
+
+        cache_name = 'i3ipc-glib-socket-%s' % os.environ['DISPLAY'].replace('/', '_')
+        cache_path = os.path.join(GLib.get_user_runtime_dir(), cache_name)
+
+        with open(cache_path) as f:
+            assert f.read() == socket_path
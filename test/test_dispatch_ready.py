@@ -0,0 +1,31 @@
+from ipctest import IpcTest
+from gi.repository import GLib
+import select
+
+
+class TestDispatchReady(IpcTest):
+    def test_dispatch_ready(self, i3):
+        events = []
+
+        def on_workspace(conn, e):
+            events.append(e)
+
+        i3.detach()
+        i3.on('workspace::focus', on_workspace)
+        assert i3.dispatch_ready()
+
+        fd = i3.get_event_fd()
+        assert fd >= 0
+        assert i3.get_event_condition() & GLib.IOCondition.IN
+        assert i3.get_command_condition() == 0
+
+        i3.command('workspace %s-dispatch' % self.fresh_workspace())
+
+        while not events:
+            readable, _, _ = select.select([fd], [], [], 2)
+            assert readable
+            assert i3.dispatch_ready()
+
+        assert len(events) == 1
+
+        i3.attach(None)
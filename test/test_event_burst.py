@@ -0,0 +1,22 @@
+from ipctest import IpcTest
+from gi.repository import GLib
+
+
+class TestEventBurst(IpcTest):
+    def test_event_burst(self, i3):
+        loop = GLib.MainLoop()
+        events = []
+        names = [self.fresh_workspace() + '-burst-%d' % i for i in range(20)]
+
+        def on_workspace(conn, e):
+            events.append(e)
+            if len(events) == len(names):
+                loop.quit()
+
+        i3.on('workspace::focus', on_workspace)
+        i3.command('; '.join('workspace %s' % name for name in names))
+        GLib.timeout_add(2000, loop.quit)
+        loop.run()
+
+        assert len(events) == len(names)
+        assert [e.current.props.name for e in events] == names
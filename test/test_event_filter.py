@@ -0,0 +1,28 @@
+from ipctest import IpcTest
+from gi.repository import GLib
+
+
+class TestEventFilter(IpcTest):
+    def run_loop(self, i3, name):
+        loop = GLib.MainLoop()
+        i3.command('workspace %s' % name)
+        GLib.timeout_add(200, loop.quit)
+        loop.run()
+
+    def test_event_filter(self, i3):
+        detailed = []
+        undetailed = []
+
+        # only the init events are decoded for this one
+        handler = i3.connect('workspace::init', lambda conn, e: detailed.append(e.change))
+        self.run_loop(i3, self.fresh_workspace() + '-filter')
+        assert detailed == ['init']
+
+        # a handler without a detail still gets every event
+        other = i3.connect('workspace', lambda conn, e: undetailed.append(e.change))
+        self.run_loop(i3, self.fresh_workspace() + '-filter')
+        assert 'init' in undetailed and 'focus' in undetailed
+        assert detailed == ['init', 'init']
+
+        i3.disconnect(handler)
+        i3.disconnect(other)
@@ -0,0 +1,24 @@
+from ipctest import IpcTest
+from gi.repository import GLib
+
+
+class TestEventPool(IpcTest):
+    def test_kept_events_are_not_recycled(self, i3):
+        loop = GLib.MainLoop()
+        events = []
+        # more events than the pool holds, so released ones are reused
+        names = [self.fresh_workspace() + '-pool-%d' % i for i in range(40)]
+
+        def on_workspace(conn, e):
+            events.append(e)
+            if len(events) == len(names):
+                loop.quit()
+
+        handler = i3.connect('workspace::focus', on_workspace)
+        i3.command('; '.join('workspace %s' % name for name in names))
+        GLib.timeout_add(2000, loop.quit)
+        loop.run()
+        i3.disconnect(handler)
+
+        assert [e.change for e in events] == ['focus'] * len(names)
+        assert [e.current.props.name for e in events] == names
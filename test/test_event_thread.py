@@ -0,0 +1,29 @@
+from ipctest import IpcTest
+from gi.repository import GLib
+import threading
+
+
+class TestEventThread(IpcTest):
+    def test_event_thread(self, i3):
+        i3.props.event_thread = True
+        loop = GLib.MainLoop()
+        events = []
+        threads = set()
+        names = [self.fresh_workspace() + '-thread-%d' % i for i in range(20)]
+
+        def on_workspace(conn, e):
+            events.append(e)
+            threads.add(threading.current_thread())
+            if len(events) == len(names):
+                loop.quit()
+
+        handler = i3.connect('workspace::focus', on_workspace)
+        i3.command('; '.join('workspace %s' % name for name in names))
+        GLib.timeout_add(2000, loop.quit)
+        loop.run()
+        i3.disconnect(handler)
+        i3.props.event_thread = False
+
+        assert [e.current.props.name for e in events] == names
+        # only the signals are emitted from the main context
+        assert threads == {threading.main_thread()}
@@ -0,0 +1,29 @@
+from ipctest import IpcTest
+from gi.repository import i3ipc, GLib
+
+
+class TestEventsBatch(IpcTest):
+    def test_events_batch(self, i3):
+        loop = GLib.MainLoop()
+        batches = []
+        focused = []
+        names = [self.fresh_workspace() + '-batch-%d' % i for i in range(20)]
+
+        def on_events(conn, events):
+            batches.append([e.current.props.name for e in events if e.change == 'focus'])
+            if sum(len(b) for b in batches) == len(names):
+                loop.quit()
+
+        i3.subscribe(i3ipc.Event.WORKSPACE)
+        handler = i3.connect('events', on_events)
+        # the signals of the event types are still emitted
+        other = i3.connect('workspace::focus', lambda conn, e: focused.append(e))
+        i3.command('; '.join('workspace %s' % name for name in names))
+        GLib.timeout_add(2000, loop.quit)
+        loop.run()
+        i3.disconnect(handler)
+        i3.disconnect(other)
+
+        assert [name for batch in batches for name in batch] == names
+        assert len(batches) < len(names)
+        assert len(focused) == len(names)
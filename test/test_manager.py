@@ -0,0 +1,44 @@
+from ipctest import IpcTest
+from gi.repository import i3ipc, GLib, GObject
+
+
+class TestManager(IpcTest):
+    def test_manager(self, i3):
+        name = self.fresh_workspace() + '-manager'
+        manager = i3ipc.ConnectionManager.new(None)
+        first = manager.add_socket(i3.props.socket_path)
+        second = manager.add_socket(i3.props.socket_path)
+        assert manager.props.size == 2
+        assert manager.subscribe(i3ipc.Event.WORKSPACE)
+
+        loop = GLib.MainLoop()
+        sources = []
+
+        def on_workspace(manager, conn, e):
+            sources.append(conn)
+            if len(sources) == 2:
+                loop.quit()
+
+        manager.connect('workspace::focus', on_workspace)
+        i3.command('workspace %s' % name)
+        GLib.timeout_add(2000, loop.quit)
+        loop.run()
+
+        # every instance gets the event, tagged with its own connection
+        assert sorted(sources, key=id) == sorted([first, second], key=id)
+
+        manager.remove(first)
+        assert manager.get_connections() == [second]
+
+    def test_forwards_subscribed_events_only(self, i3):
+        manager = i3ipc.ConnectionManager.new(None)
+        conn = manager.add_socket(i3.props.socket_path)
+        assert manager.subscribe(i3ipc.Event.WORKSPACE)
+
+        def has_handler(name):
+            signal_id = GObject.signal_lookup(name, conn)
+            return GObject.signal_has_handler_pending(conn, signal_id, 0, False)
+
+        # the connection still skips the events the manager does not want
+        assert has_handler('workspace')
+        assert not has_handler('window')
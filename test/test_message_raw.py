@@ -0,0 +1,19 @@
+from ipctest import IpcTest
+from gi.repository import GLib, i3ipc
+import json
+
+
+class TestMessageRaw(IpcTest):
+    def test_message_raw(self, i3):
+        reply = i3.message_raw(i3ipc.MessageType.GET_VERSION, None)
+        version = json.loads(reply.get_data().decode())
+
+        assert version['major'] == i3.get_version().major
+        assert reply.get_size() == len(i3.message(i3ipc.MessageType.GET_VERSION, None))
+
+    def test_message_bytes(self, i3):
+        payload = GLib.Bytes.new(b'nop; nop')
+        reply = json.loads(i3.message_bytes(i3ipc.MessageType.COMMAND, payload))
+
+        assert len(reply) == 2
+        assert all(r['success'] for r in reply)
@@ -0,0 +1,36 @@
+from ipctest import IpcTest
+from gi.repository import i3ipc, GLib, GObject
+
+
+class TestNarrowing(IpcTest):
+    def test_narrowing(self, i3):
+        conn = i3ipc.Connection.new(None)
+        conn.on('window::focus', lambda conn, e: None)
+        conn.on('workspace', lambda conn, e: None)
+
+        assert conn.get_event_handlers(i3ipc.Event.WINDOW | i3ipc.Event.WORKSPACE) == 2
+        assert conn.props.subscriptions == i3ipc.Event.WINDOW | i3ipc.Event.WORKSPACE
+
+        # the subscriptions are dropped from the events context
+        GObject.signal_handlers_destroy(conn)
+        context = GLib.MainContext.default()
+        while context.pending():
+            context.iteration(False)
+
+        assert conn.get_event_handlers(i3ipc.Event.WINDOW | i3ipc.Event.WORKSPACE) == 0
+        assert conn.props.subscriptions == 0
+
+        # the new socket still gets the events asked for later
+        events = []
+        loop = GLib.MainLoop()
+
+        def on_workspace(conn, e):
+            events.append(e)
+            loop.quit()
+
+        conn.on('workspace::focus', on_workspace)
+        i3.command('workspace %s-narrowed' % self.fresh_workspace())
+        GLib.timeout_add(2000, loop.quit)
+        loop.run()
+
+        assert events
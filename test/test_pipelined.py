@@ -0,0 +1,25 @@
+from ipctest import IpcTest
+from gi.repository import i3ipc
+import json
+
+
+class TestPipelined(IpcTest):
+    def test_message_pipelined(self, i3):
+        types = [
+            i3ipc.MessageType.GET_VERSION,
+            i3ipc.MessageType.COMMAND,
+            i3ipc.MessageType.GET_MARKS,
+        ]
+        replies = i3.message_pipelined(types, ['', 'nop', ''])
+
+        assert len(replies) == 3
+        assert 'major' in json.loads(replies[0])
+        assert json.loads(replies[1])[0]['success']
+        assert isinstance(json.loads(replies[2]), list)
+
+    def test_message_pipelined_no_payloads(self, i3):
+        types = [i3ipc.MessageType.GET_TREE, i3ipc.MessageType.GET_WORKSPACES]
+        replies = i3.message_pipelined(types, None)
+
+        assert json.loads(replies[0])['type'] == 'root'
+        assert isinstance(json.loads(replies[1]), list)
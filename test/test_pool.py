@@ -0,0 +1,52 @@
+from gi.repository import i3ipc
+from test_transport import read_message, write_message
+import json
+import select
+import threading
+
+REPLIES = {
+    i3ipc.MessageType.GET_TREE: {'id': 1, 'type': 'root', 'nodes': [], 'floating_nodes': []},
+    i3ipc.MessageType.GET_WORKSPACES: [],
+    i3ipc.MessageType.GET_OUTPUTS: [],
+    i3ipc.MessageType.GET_MARKS: ['a', 'b'],
+}
+
+
+class TestPool:
+    def test_get_state(self):
+        transport = i3ipc.SocketpairTransport.new()
+        pool = i3ipc.ConnectionPool.new_with_transport(transport, 4)
+
+        assert pool.get_size() == 4
+        assert transport.get_n_peers() == 4
+
+        fds = [transport.get_peer_fd(i) for i in range(4)]
+
+        def serve():
+            # the queries may go out on any of the sockets
+            for _ in range(len(REPLIES)):
+                fd = select.select(fds, [], [])[0][0]
+                msg_type, payload = read_message(fd)
+                write_message(fd, msg_type, json.dumps(REPLIES[msg_type]).encode())
+
+        server = threading.Thread(target=serve)
+        server.start()
+        ok, tree, workspaces, outputs, marks = pool.get_state()
+        server.join()
+
+        assert ok
+        assert tree.props.type == 'root'
+        assert workspaces == []
+        assert outputs == []
+        assert marks == ['a', 'b']
+
+    def test_acquire_idle(self):
+        transport = i3ipc.SocketpairTransport.new()
+        pool = i3ipc.ConnectionPool.new_with_transport(transport, 2)
+
+        first = pool.acquire()
+        second = pool.acquire()
+        assert first != second
+
+        pool.release(first)
+        assert pool.acquire() == first
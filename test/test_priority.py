@@ -0,0 +1,41 @@
+from gi.repository import i3ipc
+from test_transport import read_message, write_message
+import threading
+
+
+class TestPriority:
+    def test_high_priority_skips_queue(self):
+        transport = i3ipc.SocketpairTransport.new()
+        conn = i3ipc.Connection.new_with_transport(transport)
+        cmd_fd = transport.get_peer_fd(0)
+        replies = []
+
+        def send_normal():
+            replies.append(conn.message(i3ipc.MessageType.GET_TREE, None))
+
+        # the normal request stays unanswered until the urgent one is done
+        background = threading.Thread(target=send_normal)
+        background.start()
+        msg_type, payload = read_message(cmd_fd)
+        assert msg_type == i3ipc.MessageType.GET_TREE
+
+        def serve_high():
+            while transport.get_n_peers() < 2:
+                pass
+            high_fd = transport.get_peer_fd(1)
+            msg_type, payload = read_message(high_fd)
+            write_message(high_fd, msg_type, payload)
+
+        server = threading.Thread(target=serve_high)
+        server.start()
+        reply = conn.message_full(i3ipc.MessageType.COMMAND, 'focus left',
+                                  i3ipc.MessagePriority.HIGH, -1, None)
+        server.join()
+
+        assert reply == 'focus left'
+        assert not replies
+
+        write_message(cmd_fd, i3ipc.MessageType.GET_TREE, b'"tree"')
+        background.join()
+
+        assert replies == ['"tree"']
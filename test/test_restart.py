@@ -1,10 +1,28 @@
 from ipctest import IpcTest
-import pytest
+from gi.repository import GLib, i3ipc
 
 
-@pytest.mark.skip(reason='TODO')
 class TestRestart(IpcTest):
     def test_auto_reconnect(self, i3):
-        i3.auto_reconnect = True
+        i3.props.auto_reconnect = True
         i3.command('restart')
         assert i3.command('nop')
+
+    def test_subscriptions_replayed(self, i3):
+        i3.props.auto_reconnect = True
+        i3.subscribe(i3ipc.Event.WORKSPACE)
+        gaps = []
+
+        def on_reconnected(conn, gap):
+            gaps.append(gap)
+            conn.main_quit()
+
+        handler = i3.connect('reconnected', on_reconnected)
+        GLib.timeout_add(10, lambda: i3.command('restart') and False)
+        i3.main()
+        i3.disconnect(handler)
+
+        assert len(gaps) == 1
+        assert gaps[0] > 0
+        assert i3.props.connected
+        assert i3.props.subscriptions & i3ipc.Event.WORKSPACE
@@ -0,0 +1,39 @@
+from gi.repository import i3ipc
+from test_transport import read_message, write_message
+import threading
+
+N_THREADS = 8
+N_MESSAGES = 50
+
+
+class TestThreads:
+    def test_concurrent_messages(self):
+        transport = i3ipc.SocketpairTransport.new()
+        conn = i3ipc.Connection.new_with_transport(transport)
+        cmd_fd = transport.get_peer_fd(0)
+
+        def serve():
+            # every reply echoes its request, so a misrouted one shows
+            for _ in range(N_THREADS * N_MESSAGES):
+                msg_type, payload = read_message(cmd_fd)
+                write_message(cmd_fd, msg_type, payload)
+
+        replies = {}
+
+        def send(n):
+            replies[n] = []
+            for i in range(N_MESSAGES):
+                payload = 'thread %d message %d' % (n, i)
+                replies[n].append(conn.message(i3ipc.MessageType.COMMAND, payload) == payload)
+
+        server = threading.Thread(target=serve)
+        server.start()
+        clients = [threading.Thread(target=send, args=(n, )) for n in range(N_THREADS)]
+        for client in clients:
+            client.start()
+        for client in clients:
+            client.join()
+        server.join()
+
+        assert len(replies) == N_THREADS
+        assert all(all(r) for r in replies.values())
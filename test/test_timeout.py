@@ -0,0 +1,40 @@
+from gi.repository import Gio, GLib, i3ipc
+from test_transport import read_message, write_message
+import pytest
+import threading
+
+
+class TestTimeout:
+    def test_late_reply_discarded(self):
+        transport = i3ipc.SocketpairTransport.new()
+        conn = i3ipc.Connection.new_with_transport(transport)
+        cmd_fd = transport.get_peer_fd(0)
+
+        with pytest.raises(GLib.Error) as excinfo:
+            conn.message_full(i3ipc.MessageType.GET_VERSION, None,
+                              i3ipc.MessagePriority.NORMAL, 50, None)
+        assert excinfo.value.matches(Gio.io_error_quark(), Gio.IOErrorEnum.TIMED_OUT)
+
+        def serve():
+            # answer the request that timed out, then the next one
+            for reply in (b'"late"', b'"on time"'):
+                msg_type, payload = read_message(cmd_fd)
+                write_message(cmd_fd, msg_type, reply)
+
+        server = threading.Thread(target=serve)
+        server.start()
+        reply = conn.message(i3ipc.MessageType.GET_VERSION, None)
+        server.join()
+
+        assert reply == '"on time"'
+
+    def test_cancelled(self):
+        transport = i3ipc.SocketpairTransport.new()
+        conn = i3ipc.Connection.new_with_transport(transport)
+        cancellable = Gio.Cancellable()
+        threading.Timer(0.05, cancellable.cancel).start()
+
+        with pytest.raises(GLib.Error) as excinfo:
+            conn.message_full(i3ipc.MessageType.GET_VERSION, None,
+                              i3ipc.MessagePriority.NORMAL, -1, cancellable)
+        assert excinfo.value.matches(Gio.io_error_quark(), Gio.IOErrorEnum.CANCELLED)
@@ -0,0 +1,85 @@
+from gi.repository import i3ipc
+import json
+import os
+import struct
+import threading
+
+MAGIC = b'i3-ipc'
+HEADER = '=6sII'
+HEADER_SIZE = struct.calcsize(HEADER)
+
+
+def read_message(fd):
+    header = b''
+    while len(header) < HEADER_SIZE:
+        header += os.read(fd, HEADER_SIZE - len(header))
+    magic, size, msg_type = struct.unpack(HEADER, header)
+    assert magic == MAGIC
+    payload = b''
+    while len(payload) < size:
+        payload += os.read(fd, size - len(payload))
+    return msg_type, payload
+
+
+def write_message(fd, msg_type, payload):
+    os.write(fd, struct.pack(HEADER, MAGIC, len(payload), msg_type) + payload)
+
+
+class TestTransport:
+    def test_socketpair(self):
+        transport = i3ipc.SocketpairTransport.new()
+        conn = i3ipc.Connection.new_with_transport(transport)
+
+        # the socket for the events is only opened with a subscription
+        assert transport.get_n_peers() == 1
+        cmd_fd = transport.get_peer_fd(0)
+
+        def serve():
+            msg_type, payload = read_message(cmd_fd)
+            assert msg_type == i3ipc.MessageType.COMMAND
+            assert payload == b'nop'
+            write_message(cmd_fd, msg_type, json.dumps([{'success': True}]).encode())
+
+        server = threading.Thread(target=serve)
+        server.start()
+        reply = conn.command('nop')
+        server.join()
+
+        assert len(reply) == 1
+        assert reply[0].success
+
+    def test_lazy_subscription_socket(self):
+        transport = i3ipc.SocketpairTransport.new()
+        conn = i3ipc.Connection.new_with_transport(transport)
+        servers = []
+
+        def serve(fd):
+            msg_type, payload = read_message(fd)
+            assert msg_type == i3ipc.MessageType.SUBSCRIBE
+            assert json.loads(payload) == ['workspace']
+            write_message(fd, msg_type, json.dumps({'success': True}).encode())
+
+        def on_peer_opened(transport, index, fd):
+            server = threading.Thread(target=serve, args=(fd, ))
+            server.start()
+            servers.append(server)
+
+        transport.connect('peer-opened', on_peer_opened)
+
+        assert transport.get_n_peers() == 1
+        reply = conn.subscribe(i3ipc.Event.WORKSPACE)
+        servers[0].join()
+
+        assert reply.success
+        assert transport.get_n_peers() == 2
+
+    def test_hung_up_peers_are_closed(self):
+        transport = i3ipc.SocketpairTransport.new()
+        os.close(transport.open())
+
+        # the peer of a socket that was closed goes with the next one
+        fd = transport.open()
+        assert transport.get_n_peers() == 2
+        assert transport.get_peer_fd(0) == -1
+        assert transport.get_peer_fd(1) >= 0
+        os.close(fd)